@@ -6,6 +6,15 @@
 #include <random>
 #include <cmath>
 #include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <cstdio>
+#include <cstring>
+#include <cctype>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 // Screen dimensions
 const int SCREEN_WIDTH = 800;
@@ -21,18 +30,419 @@ const int ENEMY_WIDTH = 75;
 const int ENEMY_HEIGHT = 75;
 const int ENEMY_SPEED = 3;
 
+// Swarm steering constants (enemies seek the player, keep apart and fly in formation)
+const float SEEK_RANGE = 1200.0f;         // Enemies farther from the player cruise instead
+const float SEEK_WEIGHT = 0.06f;
+const float SEPARATION_RADIUS = 40.0f;
+const float SEPARATION_WEIGHT = 6.0f;
+const float NEIGHBOUR_RADIUS = 64.0f;     // Neighbours that count towards alignment (at most half a grid cell)
+const float ALIGNMENT_WEIGHT = 0.05f;
+const int MAX_NEIGHBOURS = 12;            // Neighbours used per enemy
+const int MAX_NEIGHBOUR_CANDIDATES = 32;  // Grid entries examined per enemy
+const int SWARM_CHUNK = 512;              // Enemies per work item
+const int MAX_WORKERS = 15;
+
 // Bullet constants
 const int BULLET_WIDTH = 8;
 const int BULLET_HEIGHT = 8;
 const int BULLET_SPEED = 10;
 
-// Structure to hold entity data (player, enemies, bullets)
+// Station constants (a spinning core ringed by cannon pods)
+const int STATION_CORE_SIZE = 96;
+const int STATION_POD_SIZE = 36;
+const int STATION_PODS = 6;
+const int STATION_POD_DISTANCE = 64; // From the core's centre to each pod's centre
+const int STATION_REACH = STATION_POD_DISTANCE + STATION_POD_SIZE / 2; // Bounding radius of a whole station
+const float STATION_SPIN = 0.5f; // Degrees per frame
+const int DEFAULT_STATIONS = 60;
+const SDL_Rect STATION_POD_CLIP = {0, 0, 72, 63}; // First ship in 3enemies.png
+
+// World constants (the sector wraps around at its edges)
+const int WORLD_WIDTH = SCREEN_WIDTH * 16;
+const int WORLD_HEIGHT = SCREEN_HEIGHT * 16;
+const int ASTEROID_MIN_SIZE = 16;
+const int ASTEROID_MAX_SIZE = 48;
+const int DEFAULT_WORLD_OBJECTS = 2000; // Split evenly between enemies and asteroids
+
+// Spatial grid constants
+const int GRID_CELL_SIZE = 128;
+const int GRID_COLS = WORLD_WIDTH / GRID_CELL_SIZE;
+const int GRID_ROWS = WORLD_HEIGHT / GRID_CELL_SIZE;
+const int GRID_QUERY_MARGIN = 64; // At least the largest entity half-extent
+
+// Radar constants (the radar shows the whole sector, one cell per texel)
+const int RADAR_CELL_SIZE = 100;
+const int RADAR_COLS = WORLD_WIDTH / RADAR_CELL_SIZE;
+const int RADAR_ROWS = WORLD_HEIGHT / RADAR_CELL_SIZE;
+const int RADAR_PANEL_WIDTH = RADAR_COLS * 3 / 2;
+const int RADAR_PANEL_HEIGHT = RADAR_ROWS * 3 / 2;
+
+// Starfield constants (layers from far to near)
+const int STAR_LAYERS = 3;
+const int STARS_PER_LAYER = 16384;
+const float STAR_PARALLAX[STAR_LAYERS] = {0.2f, 0.45f, 0.8f};
+const SDL_Color STAR_COLORS[STAR_LAYERS] = {{0x50, 0x50, 0x70, 0xFF}, {0x90, 0x90, 0xB0, 0xFF}, {0xFF, 0xFF, 0xFF, 0xFF}};
+
+// Stats overlay font (3x5 pixel glyphs, three bits per row, top row first)
+const char* const FONT_CHARS = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ:./%-";
+const unsigned short FONT_GLYPHS[] = {
+  0x7B6F, 0x2C97, 0x73E7, 0x73CF, 0x5BC9, 0x79CF, 0x79EF, 0x7249, 0x7BEF, 0x7BCF,
+  0x2BED, 0x6BAE, 0x3923, 0x6B6E, 0x79A7, 0x79A4, 0x396B, 0x5BED, 0x7497, 0x126A,
+  0x5BAD, 0x4927, 0x5FED, 0x6B6D, 0x2B6A, 0x6BA4, 0x2B73, 0x6BAD, 0x388E, 0x7492,
+  0x5B6F, 0x5B6A, 0x5BFD, 0x5AAD, 0x5A92, 0x72A7, 0x0410, 0x0002, 0x12A4, 0x52A5,
+  0x01C0,
+};
+
+// Resource cache constants (bytes of unreferenced resources kept for reuse)
+const size_t TEXTURE_CACHE_IDLE_BUDGET = 16 * 1024 * 1024;
+const size_t SOUND_CACHE_IDLE_BUDGET = 4 * 1024 * 1024;
+
+// Load statistics for a resource cache
+struct CacheStats {
+  int hits;         // Lookups served from a loaded resource
+  int negativeHits; // Lookups of known-missing paths (no disk access)
+  int loads;        // Successful loads from disk
+  int failures;     // Failed loads from disk
+  int evictions;    // Idle resources freed to stay within budget
+};
+
+template <typename T>
+class ResourceCache;
+
+// Ref-counted handle to a cached resource; copying shares the resource
+template <typename T>
+class ResourceHandle {
+public:
+  ResourceHandle() : mCache(nullptr), mSlot(-1) {}
+  ResourceHandle(ResourceCache<T>* cache, int slot) : mCache(cache), mSlot(slot) {}
+  ResourceHandle(const ResourceHandle& other) : mCache(other.mCache), mSlot(other.mSlot) {
+    if (mCache != nullptr) {
+      mCache->addRef(mSlot);
+    }
+  }
+  ResourceHandle& operator=(const ResourceHandle& other) {
+    if (this != &other) {
+      ResourceHandle copy(other);
+      std::swap(mCache, copy.mCache);
+      std::swap(mSlot, copy.mSlot);
+    }
+    return *this;
+  }
+  ~ResourceHandle() { reset(); }
+
+  // Drops this handle's reference
+  void reset() {
+    if (mCache != nullptr) {
+      mCache->release(mSlot);
+      mCache = nullptr;
+      mSlot = -1;
+    }
+  }
+
+  // The shared resource, or nullptr for an empty handle
+  T* get() const { return mCache != nullptr ? mCache->resourceAt(mSlot) : nullptr; }
+
+private:
+  ResourceCache<T>* mCache;
+  int mSlot;
+};
+
+// Resources keyed by normalised path. Unreferenced resources stay loaded
+// until the idle budget is exceeded; paths that failed to load are
+// remembered so they are never probed again.
+template <typename T>
+class ResourceCache {
+public:
+  typedef T* (*LoadFunc)(const std::string& path, size_t& bytes);
+  typedef void (*FreeFunc)(T* resource);
+
+  ResourceCache(LoadFunc load, FreeFunc free, size_t idleBudget)
+      : mLoad(load), mFree(free), mIdleBudget(idleBudget), mIdleBytes(0), mResidentBytes(0), mReleaseClock(0), mStats() {}
+
+  // Returns a handle to the resource at path, loading it on first use
+  ResourceHandle<T> acquire(const std::string& path) {
+    std::string key = normalisePath(path);
+
+    auto found = mSlots.find(key);
+    if (found != mSlots.end()) {
+      ++mStats.hits;
+      addRef(found->second);
+      return ResourceHandle<T>(this, found->second);
+    }
+    if (mMissing.count(key) != 0) {
+      ++mStats.negativeHits;
+      return ResourceHandle<T>();
+    }
+
+    size_t bytes = 0;
+    T* resource = mLoad(key, bytes);
+    if (resource == nullptr) {
+      ++mStats.failures;
+      mMissing.insert(key);
+      return ResourceHandle<T>();
+    }
+    ++mStats.loads;
+
+    int slot;
+    if (mFreeSlots.empty()) {
+      slot = (int)mEntries.size();
+      mEntries.push_back(Entry());
+    } else {
+      slot = mFreeSlots.back();
+      mFreeSlots.pop_back();
+    }
+    mEntries[slot] = { key, resource, bytes, 1, 0 };
+    mSlots[key] = slot;
+    mResidentBytes += bytes;
+    return ResourceHandle<T>(this, slot);
+  }
+
+  // Frees every resource; outstanding handles must be reset first
+  void clear() {
+    for (auto& entry : mEntries) {
+      if (entry.resource != nullptr) {
+        if (entry.refCount > 0) {
+          std::cerr << "Resource " << entry.path << " freed with " << entry.refCount << " handle(s) outstanding!" << std::endl;
+        }
+        mFree(entry.resource);
+      }
+    }
+    mEntries.clear();
+    mFreeSlots.clear();
+    mSlots.clear();
+    mMissing.clear();
+    mIdleBytes = 0;
+    mResidentBytes = 0;
+  }
+
+  const CacheStats& getStats() const { return mStats; }
+  size_t getResidentBytes() const { return mResidentBytes; }
+
+  // Prints load statistics
+  void printStats(const char* name) const {
+    std::cout << name << " cache: " << mSlots.size() << " resident (" << mResidentBytes << " bytes, " << mIdleBytes << " idle), "
+              << mStats.hits << " hits, " << mStats.negativeHits << " negative hits, " << mStats.loads << " loads, "
+              << mStats.failures << " failures, " << mStats.evictions << " evictions" << std::endl;
+  }
+
+  // Lexically normalises a path so equivalent spellings share one entry
+  static std::string normalisePath(const std::string& path) {
+    std::vector<std::string> parts;
+    std::string part;
+    bool absolute = !path.empty() && (path[0] == '/' || path[0] == '\\');
+    for (size_t i = 0; i <= path.size(); ++i) {
+      char c = i < path.size() ? path[i] : '/';
+      if (c != '/' && c != '\\') {
+        part += c;
+        continue;
+      }
+      if (part == "..") {
+        if (!parts.empty() && parts.back() != "..") {
+          parts.pop_back();
+        } else if (!absolute) {
+          parts.push_back(part);
+        }
+      } else if (!part.empty() && part != ".") {
+        parts.push_back(part);
+      }
+      part.clear();
+    }
+
+    std::string normalised = absolute ? "/" : "";
+    for (size_t i = 0; i < parts.size(); ++i) {
+      normalised += (i > 0 ? "/" : "") + parts[i];
+    }
+    return normalised;
+  }
+
+private:
+  friend class ResourceHandle<T>;
+
+  struct Entry {
+    std::string path;
+    T* resource;
+    size_t bytes;
+    int refCount;
+    Uint64 releaseTime; // Order in which the entry became idle
+  };
+
+  T* resourceAt(int slot) const { return mEntries[slot].resource; }
+
+  void addRef(int slot) {
+    Entry& entry = mEntries[slot];
+    if (entry.refCount++ == 0) {
+      mIdleBytes -= entry.bytes;
+    }
+  }
+
+  void release(int slot) {
+    Entry& entry = mEntries[slot];
+    if (--entry.refCount == 0) {
+      entry.releaseTime = ++mReleaseClock;
+      mIdleBytes += entry.bytes;
+      trimIdle();
+    }
+  }
+
+  // Frees the longest-idle resources until the idle set fits the budget
+  void trimIdle() {
+    while (mIdleBytes > mIdleBudget) {
+      int oldest = -1;
+      for (int i = 0; i < (int)mEntries.size(); ++i) {
+        const Entry& entry = mEntries[i];
+        if (entry.resource != nullptr && entry.refCount == 0 && (oldest < 0 || entry.releaseTime < mEntries[oldest].releaseTime)) {
+          oldest = i;
+        }
+      }
+      if (oldest < 0) {
+        break;
+      }
+      Entry& victim = mEntries[oldest];
+      mFree(victim.resource);
+      mIdleBytes -= victim.bytes;
+      mResidentBytes -= victim.bytes;
+      mSlots.erase(victim.path);
+      victim = Entry();
+      mFreeSlots.push_back(oldest);
+      ++mStats.evictions;
+    }
+  }
+
+  LoadFunc mLoad;
+  FreeFunc mFree;
+  size_t mIdleBudget;
+  size_t mIdleBytes;
+  size_t mResidentBytes;
+  Uint64 mReleaseClock;
+  CacheStats mStats;
+  std::vector<Entry> mEntries;
+  std::vector<int> mFreeSlots;
+  std::unordered_map<std::string, int> mSlots;
+  std::unordered_set<std::string> mMissing;
+};
+
+typedef ResourceHandle<SDL_Texture> TextureHandle;
+typedef ResourceHandle<Mix_Chunk> SoundHandle;
+
+// Structure to hold entity data (player, enemies, bullets, asteroids)
 struct Entity {
-  SDL_Rect rect;
-  SDL_Texture* texture;
+  float x, y;   // World position of the top-left corner
+  float vx, vy; // Velocity in pixels per frame
+  int w, h;
+  TextureHandle texture;
   double angle; // For rotation
   int speed;
   bool active;
+  int radarCell; // Radar cell this entity is counted in, -1 if none
+};
+
+enum PartKind { PART_CORE, PART_POD };
+
+// One piece of a compound entity. Parts live in a single flat array sorted by
+// depth, so every parent precedes its children and one forward pass composes
+// all world transforms.
+struct Part {
+  int parent;             // Index of the parent part, -1 for a root
+  int firstChild;         // Children are contiguous: [firstChild, firstChild + childCount)
+  int childCount;
+  PartKind kind;
+  float localX, localY;   // Centre in the parent's frame (in the world for roots)
+  float localAngle;       // Degrees relative to the parent
+  float worldX, worldY;   // Centre in the world
+  float worldAngle;
+  float cosAngle, sinAngle; // Of worldAngle, reused by the children
+  float radius;           // Collision circle of this part alone
+  float boundRadius;      // Circle enclosing this part and all its descendants
+  int size;
+  bool active;
+};
+
+// The enemy swarm as parallel arrays (structure of arrays), so the steering
+// kernel streams through each field four enemies at a time
+struct EnemySwarm {
+  std::vector<float> x, y;           // Centre positions in the world
+  std::vector<float> vx, vy;         // Velocity in pixels per frame
+  std::vector<float> nextVx, nextVy; // Velocity being computed this frame
+  std::vector<int> radarCell;        // Radar cell each enemy is counted in, -1 if none
+  std::vector<Uint8> active;
+
+  int size() const { return (int)x.size(); }
+  void add(float px, float py, float pvx, float pvy);
+  void removeInactive();
+  void resize(int n);
+};
+
+// Persistent worker threads for data-parallel loops. run() hands out chunks
+// of an index range from an atomic counter; the calling thread works too and
+// returns once every chunk is done.
+class WorkerPool {
+public:
+  typedef void (*RangeFunc)(int begin, int end);
+
+  WorkerPool() : mStart(nullptr), mDone(nullptr), mFunc(nullptr), mCount(0), mChunk(1), mQuit(false) { SDL_AtomicSet(&mNext, 0); }
+
+  bool start(int workers);
+  void stop();
+  void run(RangeFunc func, int count, int chunk);
+  int getThreadCount() const { return (int)mThreads.size() + 1; }
+
+private:
+  static int threadMain(void* data);
+  void work();
+
+  std::vector<SDL_Thread*> mThreads;
+  SDL_sem* mStart;
+  SDL_sem* mDone;
+  SDL_atomic_t mNext; // First index of the next unclaimed chunk
+  RangeFunc mFunc;
+  int mCount;
+  int mChunk;
+  bool mQuit;
+};
+
+// Per-frame counters shown in the stats overlay
+struct FrameStats {
+  int queries;        // Grid queries issued
+  int cellsVisited;   // Grid cells walked by those queries
+  int candidates;     // Entities returned by the grid
+  int collisionTests; // Exact overlap tests performed
+  int drawn;          // Entities drawn
+  double enemiesMs;   // CPU time of steering and moving the swarm
+  double partsMs;     // CPU time of the station transform pass
+  double starsMs;     // CPU time of the starfield scroll and draw submission
+  double radarMs;     // CPU time of the radar texture upload
+  double frameMs;     // CPU time of the previous frame's update and render
+};
+
+// Uniform grid over the wrapped world. Entities are binned by their centre,
+// so queries are widened by a margin of at least the largest half-extent (a
+// loose grid). Rebuilding is a counting sort over the entity array.
+class SpatialGrid {
+public:
+  explicit SpatialGrid(int queryMargin = GRID_QUERY_MARGIN) : mQueryMargin(queryMargin), mCellStart(GRID_COLS * GRID_ROWS + 1, 0) {}
+
+  // Bins every active entity
+  void build(const std::vector<Entity>& entities);
+
+  // Bins count points given by their centres, skipping inactive ones
+  void build(const float* x, const float* y, const Uint8* active, int count);
+
+  // Copies up to maxOut indices binned in the cells within radius of (x, y).
+  // It only reads, so worker threads may call it concurrently.
+  int gather(float x, float y, float radius, int* out, int maxOut) const;
+
+  // Appends the indices of entities that may overlap the world rectangle
+  void query(float x, float y, float w, float h, std::vector<int>& out, FrameStats& stats) const;
+
+private:
+  // Turns the per-entity cells into the cell-ordered item list
+  void scatter();
+
+  int mQueryMargin;
+  std::vector<int> mCellStart; // First item of each cell; the extra entry marks the end
+  std::vector<int> mCursor;    // Scatter positions used while building
+  std::vector<int> mCellOf;    // Cell of each entity, -1 when inactive
+  std::vector<int> mItems;     // Entity indices ordered by cell
 };
 
 // Function declarations
@@ -41,17 +451,62 @@ bool loadMedia();
 void close();
 SDL_Texture* loadTexture(const std::string& path);
 Mix_Chunk* loadSound(const std::string& path);
+SDL_Texture* loadCachedTexture(const std::string& path, size_t& bytes);
+Mix_Chunk* loadCachedSound(const std::string& path, size_t& bytes);
+float wrapCoordinate(float v, float size);
+float wrapDelta(float d, float size);
+bool worldOverlap(const Entity& a, const Entity& b);
+SDL_Rect screenRect(const Entity& e);
+void spawnEnemy();
+bool swarmOverlap(const Entity& e, int i);
+void steerSwarm(int begin, int end);
+void integrateSwarm(int begin, int end);
+void createStations(int count);
+void updateParts(std::vector<Part>& parts);
+int hitPart(const std::vector<Part>& parts, int index, float x, float y, float radius, FrameStats& stats);
+int damageStation(int station, int part);
+SDL_Rect partRect(const Part& part);
+void initStarfield();
+void scrollStars(SDL_FPoint* stars, int count, float dx, float dy);
+void radarTrack(float cx, float cy, bool active, int& radarCell, std::vector<Uint16>& density);
+void radarTrack(Entity& e, std::vector<Uint16>& density);
+void updateRadar();
+void drawText(int x, int y, const std::string& text, int scale);
+void drawStats(const FrameStats& stats);
 
 // Global variables
 SDL_Window* gWindow = nullptr;
 SDL_Renderer* gRenderer = nullptr;
+ResourceCache<SDL_Texture> gTextureCache(loadCachedTexture, SDL_DestroyTexture, TEXTURE_CACHE_IDLE_BUDGET);
+ResourceCache<Mix_Chunk> gSoundCache(loadCachedSound, Mix_FreeChunk, SOUND_CACHE_IDLE_BUDGET);
 Entity gPlayer;
-std::vector<Entity> gEnemies;
+EnemySwarm gSwarm;
+TextureHandle gEnemyTexture;
+WorkerPool gWorkers;
 std::vector<Entity> gPlayerBullets;
-SDL_Texture* gBackgroundTexture = nullptr;
+std::vector<Entity> gAsteroids;
+SpatialGrid gEnemyGrid;
+SpatialGrid gAsteroidGrid;
+bool gAsteroidsDirty = true;
+std::vector<Part> gStationParts;  // Every station's parts; station i's core is part i
+std::vector<Entity> gStations;    // Bounding box of each station, for the grid and radar
+SpatialGrid gStationGrid(STATION_REACH);
+bool gStationsDirty = true;
+TextureHandle gStationTexture;
+TextureHandle gPodTexture;
+int gEnemyTarget = DEFAULT_WORLD_OBJECTS / 2;
+int gAsteroidCount = DEFAULT_WORLD_OBJECTS / 2;
+int gStationCount = DEFAULT_STATIONS;
+SDL_Texture* gRadarTexture = nullptr;
+std::vector<Uint16> gRadarEnemies(RADAR_COLS * RADAR_ROWS, 0);   // Enemies per radar cell
+std::vector<Uint16> gRadarAsteroids(RADAR_COLS * RADAR_ROWS, 0); // Asteroids per radar cell
+std::vector<Uint16> gRadarStations(RADAR_COLS * RADAR_ROWS, 0);  // Stations per radar cell
+float gCameraX = 0.0f; // World position of the view's top-left corner
+float gCameraY = 0.0f;
+std::vector<SDL_FPoint> gStars[STAR_LAYERS]; // Screen positions, one array per parallax layer
 Mix_Music* gMusic = nullptr;
-Mix_Chunk* gShootSound = nullptr;
-Mix_Chunk* gExplosionSound = nullptr;
+SoundHandle gShootSound;
+SoundHandle gExplosionSound;
 int gScore = 0;
 bool gGameOver = false;
 
@@ -95,44 +550,81 @@ bool init() {
 
 // Load media (images and sounds)
 bool loadMedia() {
-  // Load background image
-  gBackgroundTexture = loadTexture("background.png");
-  if (gBackgroundTexture == nullptr) {
-    std::cerr << "Failed to load background texture!" << std::endl;
+  // Generate the background starfield
+  initStarfield();
+
+  // Create the radar panel, refilled from the density grids every frame
+  gRadarTexture = SDL_CreateTexture(gRenderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, RADAR_COLS, RADAR_ROWS);
+  if (gRadarTexture == nullptr) {
+    std::cerr << "Unable to create radar texture! SDL Error: " << SDL_GetError() << std::endl;
     return false;
   }
+  SDL_SetTextureBlendMode(gRadarTexture, SDL_BLENDMODE_BLEND);
 
   // Load player texture
-  gPlayer.texture = loadTexture("player.png");
-  if (gPlayer.texture == nullptr) {
+  gPlayer.texture = gTextureCache.acquire("player.png");
+  if (gPlayer.texture.get() == nullptr) {
     std::cerr << "Failed to load player texture!" << std::endl;
     return false;
   }
 
   // Load enemy texture (you can add more enemy types with different textures)
-  SDL_Texture* enemyTexture = loadTexture("enemy.png");
-  if (enemyTexture == nullptr) {
+  gEnemyTexture = gTextureCache.acquire("enemy.png");
+  if (gEnemyTexture.get() == nullptr) {
     std::cerr << "Failed to load enemy texture!" << std::endl;
     return false;
   }
 
-  // Create player
-  gPlayer.rect = {SCREEN_WIDTH / 2 - PLAYER_WIDTH / 2, SCREEN_HEIGHT / 2 - PLAYER_HEIGHT / 2, PLAYER_WIDTH, PLAYER_HEIGHT};
+  // Load the station core and cannon pod textures
+  gStationTexture = gTextureCache.acquire("largeenemy.png");
+  gPodTexture = gTextureCache.acquire("3enemies.png");
+  if (gStationTexture.get() == nullptr || gPodTexture.get() == nullptr) {
+    std::cerr << "Failed to load station textures!" << std::endl;
+    return false;
+  }
+
+  // Create player in the middle of the sector, with the camera on it
+  gPlayer.x = WORLD_WIDTH / 2 - PLAYER_WIDTH / 2;
+  gPlayer.y = WORLD_HEIGHT / 2 - PLAYER_HEIGHT / 2;
+  gPlayer.vx = 0.0f;
+  gPlayer.vy = 0.0f;
+  gPlayer.w = PLAYER_WIDTH;
+  gPlayer.h = PLAYER_HEIGHT;
   gPlayer.angle = 0.0;
   gPlayer.speed = PLAYER_SPEED;
   gPlayer.active = true;
+  gPlayer.radarCell = -1;
+  gCameraX = gPlayer.x + PLAYER_WIDTH / 2 - SCREEN_WIDTH / 2;
+  gCameraY = gPlayer.y + PLAYER_HEIGHT / 2 - SCREEN_HEIGHT / 2;
 
-  // Create initial enemies (example)
-  for (int i = 0; i < 10; ++i) {
-    Entity enemy;
-    enemy.rect = {rand() % SCREEN_WIDTH, rand() % SCREEN_HEIGHT, ENEMY_WIDTH, ENEMY_HEIGHT};
-    enemy.texture = enemyTexture;
-    enemy.angle = 0.0;
-    enemy.speed = ENEMY_SPEED;
-    enemy.active = true;
-    gEnemies.push_back(enemy);
+  // Create initial enemies across the whole sector
+  for (int i = 0; i < gEnemyTarget; ++i) {
+    spawnEnemy();
   }
 
+  // Scatter stationary asteroids
+  gAsteroids.reserve(gAsteroidCount);
+  for (int i = 0; i < gAsteroidCount; ++i) {
+    Entity asteroid;
+    int size = ASTEROID_MIN_SIZE + rand() % (ASTEROID_MAX_SIZE - ASTEROID_MIN_SIZE + 1);
+    asteroid.x = (float)(rand() % WORLD_WIDTH);
+    asteroid.y = (float)(rand() % WORLD_HEIGHT);
+    asteroid.vx = 0.0f;
+    asteroid.vy = 0.0f;
+    asteroid.w = size;
+    asteroid.h = size;
+    asteroid.angle = 0.0;
+    asteroid.speed = 0;
+    asteroid.active = true;
+    asteroid.radarCell = -1;
+    radarTrack(asteroid, gRadarAsteroids);
+    gAsteroids.push_back(asteroid);
+  }
+  gAsteroidsDirty = true;
+
+  // Build the stations away from the player's start
+  createStations(gStationCount);
+
   // Load sounds
   gMusic = Mix_LoadMUS("music.wav");
   if (gMusic == nullptr) {
@@ -140,14 +632,14 @@ bool loadMedia() {
     return false;
   }
 
-  gShootSound = loadSound("shoot.wav");
-  if (gShootSound == nullptr) {
+  gShootSound = gSoundCache.acquire("shoot.wav");
+  if (gShootSound.get() == nullptr) {
     std::cerr << "Failed to load shoot sound!" << std::endl;
     return false;
   }
 
-  gExplosionSound = loadSound("explosion.wav");
-  if (gExplosionSound == nullptr) {
+  gExplosionSound = gSoundCache.acquire("explosion.wav");
+  if (gExplosionSound.get() == nullptr) {
     std::cerr << "Failed to load explosion sound!" << std::endl;
     return false;
   }
@@ -157,23 +649,29 @@ bool loadMedia() {
 
 // Free media and shut down SDL
 void close() {
-  // Free loaded images
-  SDL_DestroyTexture(gBackgroundTexture);
-  gBackgroundTexture = nullptr;
-  SDL_DestroyTexture(gPlayer.texture);
-  gPlayer.texture = nullptr;
-  for (auto& enemy : gEnemies) {
-    SDL_DestroyTexture(enemy.texture);
-    enemy.texture = nullptr;
-  }
+  // Drop every handle, then free the cached images and sounds once each
+  gPlayer.texture.reset();
+  gWorkers.stop();
+  gSwarm.resize(0);
+  gEnemyTexture.reset();
+  gPlayerBullets.clear();
+  gAsteroids.clear();
+  gStations.clear();
+  gStationParts.clear();
+  gStationTexture.reset();
+  gPodTexture.reset();
+  SDL_DestroyTexture(gRadarTexture);
+  gRadarTexture = nullptr;
+  gShootSound.reset();
+  gExplosionSound.reset();
+  gTextureCache.printStats("Texture");
+  gSoundCache.printStats("Sound");
+  gTextureCache.clear();
+  gSoundCache.clear();
 
-  // Free sounds
+  // Free music
   Mix_FreeMusic(gMusic);
   gMusic = nullptr;
-  Mix_FreeChunk(gShootSound);
-  gShootSound = nullptr;
-  Mix_FreeChunk(gExplosionSound);
-  gExplosionSound = nullptr;
 
   // Destroy window
   SDL_DestroyRenderer(gRenderer);
@@ -212,14 +710,729 @@ Mix_Chunk* loadSound(const std::string& path) {
   return sound;
 }
 
+// Cache loader for textures; reports the texture's approximate size
+SDL_Texture* loadCachedTexture(const std::string& path, size_t& bytes) {
+  SDL_Texture* texture = loadTexture(path);
+  if (texture != nullptr) {
+    int w = 0;
+    int h = 0;
+    SDL_QueryTexture(texture, nullptr, nullptr, &w, &h);
+    bytes = (size_t)w * h * 4;
+  }
+  return texture;
+}
+
+// Cache loader for sounds; reports the decoded sample size
+Mix_Chunk* loadCachedSound(const std::string& path, size_t& bytes) {
+  Mix_Chunk* sound = loadSound(path);
+  if (sound != nullptr) {
+    bytes = sound->alen;
+  }
+  return sound;
+}
+
+// Wraps a world coordinate into [0, size)
+float wrapCoordinate(float v, float size) {
+  v = std::fmod(v, size);
+  return v < 0.0f ? v + size : v;
+}
+
+// Shortest signed distance for an offset on a wrapped axis
+float wrapDelta(float d, float size) {
+  d = std::fmod(d, size);
+  if (d >= size / 2) {
+    d -= size;
+  } else if (d < -size / 2) {
+    d += size;
+  }
+  return d;
+}
+
+// wrapDelta for offsets already within (-size, size), without the division
+static inline float wrapNear(float d, float size) {
+  return d - size * (float)(d >= size / 2) + size * (float)(d < -size / 2);
+}
+
+// Wraps a grid cell index into [0, n)
+static int wrapIndex(int i, int n) {
+  i %= n;
+  return i < 0 ? i + n : i;
+}
+
+// Whether two entities overlap, measured across the world's wrapped edges
+bool worldOverlap(const Entity& a, const Entity& b) {
+  float dx = wrapDelta(b.x - a.x, WORLD_WIDTH);
+  float dy = wrapDelta(b.y - a.y, WORLD_HEIGHT);
+  return dx < a.w && -dx < b.w && dy < a.h && -dy < b.h;
+}
+
+// Where an entity appears on screen relative to the camera
+SDL_Rect screenRect(const Entity& e) {
+  return {(int)std::floor(wrapDelta(e.x - gCameraX, WORLD_WIDTH)), (int)std::floor(wrapDelta(e.y - gCameraY, WORLD_HEIGHT)), e.w, e.h};
+}
+
+void EnemySwarm::add(float px, float py, float pvx, float pvy) {
+  x.push_back(px);
+  y.push_back(py);
+  vx.push_back(pvx);
+  vy.push_back(pvy);
+  nextVx.push_back(pvx);
+  nextVy.push_back(pvy);
+  radarCell.push_back(-1);
+  active.push_back(1);
+}
+
+// Compacts the arrays over destroyed enemies, keeping the survivors in order
+void EnemySwarm::removeInactive() {
+  int kept = 0;
+  for (int i = 0; i < size(); ++i) {
+    if (active[i]) {
+      x[kept] = x[i];
+      y[kept] = y[i];
+      vx[kept] = vx[i];
+      vy[kept] = vy[i];
+      radarCell[kept] = radarCell[i];
+      active[kept] = 1;
+      ++kept;
+    }
+  }
+  resize(kept);
+}
+
+void EnemySwarm::resize(int n) {
+  x.resize(n);
+  y.resize(n);
+  vx.resize(n);
+  vy.resize(n);
+  nextVx.resize(n);
+  nextVy.resize(n);
+  radarCell.resize(n);
+  active.resize(n);
+}
+
+bool WorkerPool::start(int workers) {
+  mStart = SDL_CreateSemaphore(0);
+  mDone = SDL_CreateSemaphore(0);
+  if (mStart == nullptr || mDone == nullptr) {
+    std::cerr << "Unable to create worker semaphores! SDL Error: " << SDL_GetError() << std::endl;
+    return false;
+  }
+  for (int i = 0; i < workers; ++i) {
+    SDL_Thread* thread = SDL_CreateThread(threadMain, "Worker", this);
+    if (thread == nullptr) {
+      std::cerr << "Unable to create worker thread! SDL Error: " << SDL_GetError() << std::endl;
+      break; // Carry on with the workers we have
+    }
+    mThreads.push_back(thread);
+  }
+  return true;
+}
+
+void WorkerPool::stop() {
+  mQuit = true;
+  for (size_t i = 0; i < mThreads.size(); ++i) {
+    SDL_SemPost(mStart);
+  }
+  for (SDL_Thread* thread : mThreads) {
+    SDL_WaitThread(thread, nullptr);
+  }
+  mThreads.clear();
+  SDL_DestroySemaphore(mStart);
+  SDL_DestroySemaphore(mDone);
+  mStart = nullptr;
+  mDone = nullptr;
+}
+
+void WorkerPool::run(RangeFunc func, int count, int chunk) {
+  mFunc = func;
+  mCount = count;
+  mChunk = chunk;
+  SDL_AtomicSet(&mNext, 0);
+  for (size_t i = 0; i < mThreads.size(); ++i) {
+    SDL_SemPost(mStart);
+  }
+  work();
+  for (size_t i = 0; i < mThreads.size(); ++i) {
+    SDL_SemWait(mDone);
+  }
+}
+
+int WorkerPool::threadMain(void* data) {
+  WorkerPool* pool = static_cast<WorkerPool*>(data);
+  for (;;) {
+    SDL_SemWait(pool->mStart);
+    if (pool->mQuit) {
+      break;
+    }
+    pool->work();
+    SDL_SemPost(pool->mDone);
+  }
+  return 0;
+}
+
+void WorkerPool::work() {
+  for (;;) {
+    int begin = SDL_AtomicAdd(&mNext, mChunk);
+    if (begin >= mCount) {
+      break;
+    }
+    mFunc(begin, std::min(begin + mChunk, mCount));
+  }
+}
+
+// Creates an enemy at a random place in the sector, outside the current view
+void spawnEnemy() {
+  float x, y;
+  do {
+    x = (float)(rand() % WORLD_WIDTH);
+    y = (float)(rand() % WORLD_HEIGHT);
+  } while (std::fabs(wrapDelta(x - gCameraX + ENEMY_WIDTH / 2, WORLD_WIDTH) - SCREEN_WIDTH / 2) < SCREEN_WIDTH / 2 + ENEMY_WIDTH &&
+           std::fabs(wrapDelta(y - gCameraY + ENEMY_HEIGHT / 2, WORLD_HEIGHT) - SCREEN_HEIGHT / 2) < SCREEN_HEIGHT / 2 + ENEMY_HEIGHT);
+
+  double heading = (rand() % 360) * M_PI / 180;
+  gSwarm.add(x, y, (float)(ENEMY_SPEED * cos(heading)), (float)(ENEMY_SPEED * sin(heading)));
+  int i = gSwarm.size() - 1;
+  radarTrack(x, y, true, gSwarm.radarCell[i], gRadarEnemies);
+}
+
+// Whether an entity overlaps enemy i of the swarm, across wrapped edges
+bool swarmOverlap(const Entity& e, int i) {
+  float dx = wrapDelta(gSwarm.x[i] - ENEMY_WIDTH / 2 - e.x, WORLD_WIDTH);
+  float dy = wrapDelta(gSwarm.y[i] - ENEMY_HEIGHT / 2 - e.y, WORLD_HEIGHT);
+  return dx < e.w && -dx < ENEMY_WIDTH && dy < e.h && -dy < ENEMY_HEIGHT;
+}
+
+#if defined(__SSE2__)
+// Approximate 1/sqrt(x) refined by one Newton-Raphson step (about 22 bits)
+static inline __m128 fastRsqrt(__m128 x) {
+  __m128 y = _mm_rsqrt_ps(x);
+  __m128 yyx = _mm_mul_ps(_mm_mul_ps(y, y), x);
+  return _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), y), _mm_sub_ps(_mm_set1_ps(3.0f), yyx));
+}
+#endif
+
+// Steers enemies [begin, end) into nextVx/nextVy. A scalar pass gathers each
+// enemy's seek, separation and alignment terms from the neighbour grid; a
+// SIMD pass combines them and renormalises every velocity to ENEMY_SPEED.
+void steerSwarm(int begin, int end) {
+  float seekX[SWARM_CHUNK], seekY[SWARM_CHUNK];
+  float pushX[SWARM_CHUNK], pushY[SWARM_CHUNK]; // Separation plus alignment
+  int candidates[MAX_NEIGHBOUR_CANDIDATES];
+  const float targetX = gPlayer.x + PLAYER_WIDTH / 2;
+  const float targetY = gPlayer.y + PLAYER_HEIGHT / 2;
+
+  for (int i = begin; i < end; ++i) {
+    int k = i - begin;
+    float x = gSwarm.x[i];
+    float y = gSwarm.y[i];
+    float dx = wrapNear(targetX - x, WORLD_WIDTH);
+    float dy = wrapNear(targetY - y, WORLD_HEIGHT);
+    bool seeking = dx * dx + dy * dy < SEEK_RANGE * SEEK_RANGE;
+    seekX[k] = seeking ? dx : 0.0f;
+    seekY[k] = seeking ? dy : 0.0f;
+
+    float separateX = 0.0f, separateY = 0.0f;
+    float sumVx = 0.0f, sumVy = 0.0f;
+    int neighbours = 0;
+    int found = gEnemyGrid.gather(x, y, NEIGHBOUR_RADIUS, candidates, MAX_NEIGHBOUR_CANDIDATES);
+    for (int c = 0; c < found && neighbours < MAX_NEIGHBOURS; ++c) {
+      int j = candidates[c];
+      float ox = wrapNear(x - gSwarm.x[j], WORLD_WIDTH);
+      float oy = wrapNear(y - gSwarm.y[j], WORLD_HEIGHT);
+      float distance = ox * ox + oy * oy;
+      if (j == i || distance >= NEIGHBOUR_RADIUS * NEIGHBOUR_RADIUS) {
+        continue;
+      }
+      ++neighbours;
+      sumVx += gSwarm.vx[j];
+      sumVy += gSwarm.vy[j];
+      if (distance < SEPARATION_RADIUS * SEPARATION_RADIUS && distance > 0.01f) {
+        float push = 1.0f / distance; // Pushes harder the closer the neighbour is
+        separateX += ox * push;
+        separateY += oy * push;
+      }
+    }
+    pushX[k] = separateX * SEPARATION_WEIGHT;
+    pushY[k] = separateY * SEPARATION_WEIGHT;
+    if (neighbours > 0) {
+      pushX[k] += (sumVx / neighbours - gSwarm.vx[i]) * ALIGNMENT_WEIGHT;
+      pushY[k] += (sumVy / neighbours - gSwarm.vy[i]) * ALIGNMENT_WEIGHT;
+    }
+  }
+
+  const float* vx = &gSwarm.vx[begin];
+  const float* vy = &gSwarm.vy[begin];
+  float* outVx = &gSwarm.nextVx[begin];
+  float* outVy = &gSwarm.nextVy[begin];
+  int n = end - begin;
+  int k = 0;
+#if defined(__SSE2__)
+  const __m128 speed = _mm_set1_ps(ENEMY_SPEED);
+  const __m128 seekWeight = _mm_set1_ps(SEEK_WEIGHT);
+  const __m128 tiny = _mm_set1_ps(1e-6f);
+  for (; k + 4 <= n; k += 4) {
+    __m128 velX = _mm_loadu_ps(vx + k);
+    __m128 velY = _mm_loadu_ps(vy + k);
+
+    // Seek: steer towards full speed along the direction to the player
+    __m128 sx = _mm_loadu_ps(seekX + k);
+    __m128 sy = _mm_loadu_ps(seekY + k);
+    __m128 length = _mm_add_ps(_mm_mul_ps(sx, sx), _mm_mul_ps(sy, sy));
+    __m128 seeking = _mm_cmpgt_ps(length, tiny);
+    __m128 scale = _mm_mul_ps(speed, fastRsqrt(_mm_max_ps(length, tiny)));
+    __m128 steerX = _mm_and_ps(seeking, _mm_mul_ps(seekWeight, _mm_sub_ps(_mm_mul_ps(sx, scale), velX)));
+    __m128 steerY = _mm_and_ps(seeking, _mm_mul_ps(seekWeight, _mm_sub_ps(_mm_mul_ps(sy, scale), velY)));
+
+    // Add separation and alignment, then hold the cruising speed
+    velX = _mm_add_ps(velX, _mm_add_ps(steerX, _mm_loadu_ps(pushX + k)));
+    velY = _mm_add_ps(velY, _mm_add_ps(steerY, _mm_loadu_ps(pushY + k)));
+    length = _mm_add_ps(_mm_mul_ps(velX, velX), _mm_mul_ps(velY, velY));
+    scale = _mm_mul_ps(speed, fastRsqrt(_mm_max_ps(length, tiny)));
+    _mm_storeu_ps(outVx + k, _mm_mul_ps(velX, scale));
+    _mm_storeu_ps(outVy + k, _mm_mul_ps(velY, scale));
+  }
+#endif
+  for (; k < n; ++k) {
+    float velX = vx[k];
+    float velY = vy[k];
+    float length = seekX[k] * seekX[k] + seekY[k] * seekY[k];
+    if (length > 1e-6f) {
+      float scale = ENEMY_SPEED / std::sqrt(length);
+      velX += (seekX[k] * scale - velX) * SEEK_WEIGHT;
+      velY += (seekY[k] * scale - velY) * SEEK_WEIGHT;
+    }
+    velX += pushX[k];
+    velY += pushY[k];
+    float scale = ENEMY_SPEED / std::sqrt(std::max(velX * velX + velY * velY, 1e-6f));
+    outVx[k] = velX * scale;
+    outVy[k] = velY * scale;
+  }
+}
+
+// Moves enemies [begin, end) by their velocity and wraps them into the sector
+void integrateSwarm(int begin, int end) {
+  float* x = &gSwarm.x[begin];
+  float* y = &gSwarm.y[begin];
+  const float* vx = &gSwarm.vx[begin];
+  const float* vy = &gSwarm.vy[begin];
+  int n = end - begin;
+  int k = 0;
+#if defined(__SSE2__)
+  const __m128 width = _mm_set1_ps(WORLD_WIDTH);
+  const __m128 height = _mm_set1_ps(WORLD_HEIGHT);
+  const __m128 zero = _mm_setzero_ps();
+  for (; k + 4 <= n; k += 4) {
+    __m128 px = _mm_add_ps(_mm_loadu_ps(x + k), _mm_loadu_ps(vx + k));
+    __m128 py = _mm_add_ps(_mm_loadu_ps(y + k), _mm_loadu_ps(vy + k));
+    px = _mm_add_ps(px, _mm_and_ps(_mm_cmplt_ps(px, zero), width));
+    px = _mm_sub_ps(px, _mm_and_ps(_mm_cmpge_ps(px, width), width));
+    py = _mm_add_ps(py, _mm_and_ps(_mm_cmplt_ps(py, zero), height));
+    py = _mm_sub_ps(py, _mm_and_ps(_mm_cmpge_ps(py, height), height));
+    _mm_storeu_ps(x + k, px);
+    _mm_storeu_ps(y + k, py);
+  }
+#endif
+  for (; k < n; ++k) {
+    float px = x[k] + vx[k];
+    float py = y[k] + vy[k];
+    x[k] = px + WORLD_WIDTH * (float)(px < 0.0f) - WORLD_WIDTH * (float)(px >= WORLD_WIDTH);
+    y[k] = py + WORLD_HEIGHT * (float)(py < 0.0f) - WORLD_HEIGHT * (float)(py >= WORLD_HEIGHT);
+  }
+}
+
+// Builds count stations as one flat part array: all cores first, then all
+// pods grouped by core, so parents always precede their children
+void createStations(int count) {
+  gStationParts.clear();
+  gStations.clear();
+  gStationParts.reserve(count * (1 + STATION_PODS));
+  gStations.reserve(count);
+
+  for (int i = 0; i < count; ++i) {
+    Part core = {};
+    core.parent = -1;
+    core.kind = PART_CORE;
+    do {
+      core.localX = (float)(rand() % WORLD_WIDTH);
+      core.localY = (float)(rand() % WORLD_HEIGHT);
+    } while (std::fabs(wrapDelta(core.localX - WORLD_WIDTH / 2, WORLD_WIDTH)) < SCREEN_WIDTH &&
+             std::fabs(wrapDelta(core.localY - WORLD_HEIGHT / 2, WORLD_HEIGHT)) < SCREEN_HEIGHT);
+    core.localAngle = (float)(rand() % 360);
+    core.size = STATION_CORE_SIZE;
+    core.radius = STATION_CORE_SIZE / 2 * 0.8f;
+    core.active = true;
+    gStationParts.push_back(core);
+  }
+
+  for (int i = 0; i < count; ++i) {
+    gStationParts[i].firstChild = (int)gStationParts.size();
+    gStationParts[i].childCount = STATION_PODS;
+    for (int k = 0; k < STATION_PODS; ++k) {
+      float angle = 360.0f * k / STATION_PODS;
+      Part pod = {};
+      pod.parent = i;
+      pod.kind = PART_POD;
+      pod.localX = STATION_POD_DISTANCE * cosf(angle * (float)M_PI / 180);
+      pod.localY = STATION_POD_DISTANCE * sinf(angle * (float)M_PI / 180);
+      pod.localAngle = angle + 90.0f; // Facing outwards
+      pod.size = STATION_POD_SIZE;
+      pod.radius = STATION_POD_SIZE / 2;
+      pod.active = true;
+      gStationParts.push_back(pod);
+    }
+  }
+
+  // Bounding circles grow from the leaves up, so walk the array backwards
+  for (int i = (int)gStationParts.size() - 1; i >= 0; --i) {
+    Part& part = gStationParts[i];
+    part.boundRadius = std::max(part.boundRadius, part.radius);
+    if (part.parent >= 0) {
+      Part& parent = gStationParts[part.parent];
+      parent.boundRadius = std::max(parent.boundRadius, std::hypot(part.localX, part.localY) + part.boundRadius);
+    }
+  }
+  updateParts(gStationParts);
+
+  // The grid and radar see each station as one box around its bounding circle
+  for (int i = 0; i < count; ++i) {
+    const Part& core = gStationParts[i];
+    Entity station;
+    station.x = core.worldX - core.boundRadius;
+    station.y = core.worldY - core.boundRadius;
+    station.vx = 0.0f;
+    station.vy = 0.0f;
+    station.w = (int)std::ceil(core.boundRadius * 2);
+    station.h = station.w;
+    station.angle = 0.0;
+    station.speed = 0;
+    station.active = true;
+    station.radarCell = -1;
+    radarTrack(station, gRadarStations);
+    gStations.push_back(station);
+  }
+  gStationsDirty = true;
+}
+
+// Composes every part's world transform from its parent's in one linear pass
+void updateParts(std::vector<Part>& parts) {
+  for (auto& part : parts) {
+    if (part.parent < 0) {
+      part.worldX = part.localX;
+      part.worldY = part.localY;
+      part.worldAngle = part.localAngle;
+    } else {
+      const Part& parent = parts[part.parent];
+      part.worldX = parent.worldX + parent.cosAngle * part.localX - parent.sinAngle * part.localY;
+      part.worldY = parent.worldY + parent.sinAngle * part.localX + parent.cosAngle * part.localY;
+      part.worldAngle = parent.worldAngle + part.localAngle;
+    }
+    if (part.childCount > 0) {
+      float radians = part.worldAngle * (float)M_PI / 180;
+      part.cosAngle = cosf(radians);
+      part.sinAngle = sinf(radians);
+    }
+  }
+}
+
+// Finds the part under a circle, rejecting whole subtrees by their bounding
+// circles before any child is tested. Returns the part index, or -1.
+int hitPart(const std::vector<Part>& parts, int index, float x, float y, float radius, FrameStats& stats) {
+  const Part& part = parts[index];
+  ++stats.collisionTests;
+  float dx = wrapDelta(x - part.worldX, WORLD_WIDTH);
+  float dy = wrapDelta(y - part.worldY, WORLD_HEIGHT);
+  float distance = dx * dx + dy * dy;
+  float reach = part.boundRadius + radius;
+  if (distance > reach * reach) {
+    return -1;
+  }
+  for (int child = part.firstChild; child < part.firstChild + part.childCount; ++child) {
+    int hit = hitPart(parts, child, x, y, radius, stats);
+    if (hit >= 0) {
+      return hit;
+    }
+  }
+  reach = part.radius + radius;
+  return part.active && distance <= reach * reach ? index : -1;
+}
+
+// Destroys one part of a station and returns the points scored. Losing the
+// core or the last pod destroys the whole station.
+int damageStation(int station, int part) {
+  Part& core = gStationParts[station];
+  gStationParts[part].active = false;
+  int podsLeft = 0;
+  for (int i = core.firstChild; i < core.firstChild + core.childCount; ++i) {
+    podsLeft += gStationParts[i].active ? 1 : 0;
+  }
+  if (part != station && podsLeft > 0) {
+    return 200;
+  }
+
+  core.active = false;
+  for (int i = core.firstChild; i < core.firstChild + core.childCount; ++i) {
+    gStationParts[i].active = false;
+  }
+  gStations[station].active = false;
+  radarTrack(gStations[station], gRadarStations);
+  gStationsDirty = true;
+  return 1500;
+}
+
+// Where a part appears on screen, centred on its world position
+SDL_Rect partRect(const Part& part) {
+  return {(int)std::floor(wrapDelta(part.worldX - part.size / 2 - gCameraX, WORLD_WIDTH)),
+          (int)std::floor(wrapDelta(part.worldY - part.size / 2 - gCameraY, WORLD_HEIGHT)), part.size, part.size};
+}
+
+// Scatters the stars of every layer across the screen
+void initStarfield() {
+  for (int layer = 0; layer < STAR_LAYERS; ++layer) {
+    gStars[layer].resize(STARS_PER_LAYER);
+    for (auto& star : gStars[layer]) {
+      star.x = (float)(rand() % (SCREEN_WIDTH * 16)) / 16;
+      star.y = (float)(rand() % (SCREEN_HEIGHT * 16)) / 16;
+    }
+  }
+}
+
+// Scrolls interleaved star positions by (dx, dy) and wraps them back onto the
+// screen without branches. Offsets must be smaller than the screen size.
+void scrollStars(SDL_FPoint* stars, int count, float dx, float dy) {
+  float* coords = &stars[0].x;
+  int n = count * 2;
+  int i = 0;
+#if defined(__SSE2__)
+  // Two stars (x, y, x, y) per register
+  const __m128 delta = _mm_setr_ps(dx, dy, dx, dy);
+  const __m128 size = _mm_setr_ps(SCREEN_WIDTH, SCREEN_HEIGHT, SCREEN_WIDTH, SCREEN_HEIGHT);
+  const __m128 zero = _mm_setzero_ps();
+  for (; i + 4 <= n; i += 4) {
+    __m128 p = _mm_add_ps(_mm_loadu_ps(coords + i), delta);
+    p = _mm_add_ps(p, _mm_and_ps(_mm_cmplt_ps(p, zero), size));
+    p = _mm_sub_ps(p, _mm_and_ps(_mm_cmpge_ps(p, size), size));
+    _mm_storeu_ps(coords + i, p);
+  }
+#endif
+  for (; i < n; i += 2) {
+    float x = coords[i] + dx;
+    float y = coords[i + 1] + dy;
+    x += SCREEN_WIDTH * (float)(x < 0.0f) - SCREEN_WIDTH * (float)(x >= SCREEN_WIDTH);
+    y += SCREEN_HEIGHT * (float)(y < 0.0f) - SCREEN_HEIGHT * (float)(y >= SCREEN_HEIGHT);
+    coords[i] = x;
+    coords[i + 1] = y;
+  }
+}
+
+// Keeps an object counted in the radar cell under its centre (none once inactive)
+void radarTrack(float cx, float cy, bool active, int& radarCell, std::vector<Uint16>& density) {
+  int cell = -1;
+  if (active) {
+    int col = std::min((int)(wrapCoordinate(cx, WORLD_WIDTH) / RADAR_CELL_SIZE), RADAR_COLS - 1);
+    int row = std::min((int)(wrapCoordinate(cy, WORLD_HEIGHT) / RADAR_CELL_SIZE), RADAR_ROWS - 1);
+    cell = row * RADAR_COLS + col;
+  }
+  if (cell != radarCell) {
+    if (radarCell >= 0) {
+      --density[radarCell];
+    }
+    if (cell >= 0) {
+      ++density[cell];
+    }
+    radarCell = cell;
+  }
+}
+
+void radarTrack(Entity& e, std::vector<Uint16>& density) {
+  radarTrack(e.x + e.w / 2, e.y + e.h / 2, e.active, e.radarCell, density);
+}
+
+// Rewrites the radar texture from the density grids. The cost depends only on
+// the radar resolution, not on how many entities the sector holds.
+void updateRadar() {
+  void* pixels = nullptr;
+  int pitch = 0;
+  if (SDL_LockTexture(gRadarTexture, nullptr, &pixels, &pitch) < 0) {
+    return;
+  }
+  for (int row = 0; row < RADAR_ROWS; ++row) {
+    Uint32* out = reinterpret_cast<Uint32*>(static_cast<Uint8*>(pixels) + row * pitch);
+    const Uint16* enemies = &gRadarEnemies[row * RADAR_COLS];
+    const Uint16* asteroids = &gRadarAsteroids[row * RADAR_COLS];
+    const Uint16* stations = &gRadarStations[row * RADAR_COLS];
+    for (int col = 0; col < RADAR_COLS; ++col) {
+      // Enemies show red, stations green and asteroids grey, brighter where they are denser
+      Uint32 red = std::min(enemies[col] * 96, 255);
+      Uint32 green = stations[col] != 0 ? 0xFF : 0;
+      Uint32 grey = std::min(asteroids[col] * 48, 160);
+      Uint32 alpha = (red | green | grey) != 0 ? 0xFF : 0x60;
+      out[col] = (alpha << 24) | (std::max(red, grey) << 16) | (std::max(green, grey) << 8) | (grey + 0x20);
+    }
+  }
+  SDL_UnlockTexture(gRadarTexture);
+}
+
+// Grid cell containing a wrapped world position
+static int cellAt(float x, float y) {
+  int cx = std::min((int)(wrapCoordinate(x, WORLD_WIDTH) / GRID_CELL_SIZE), GRID_COLS - 1);
+  int cy = std::min((int)(wrapCoordinate(y, WORLD_HEIGHT) / GRID_CELL_SIZE), GRID_ROWS - 1);
+  return cy * GRID_COLS + cx;
+}
+
+void SpatialGrid::build(const std::vector<Entity>& entities) {
+  mCellOf.resize(entities.size());
+  for (size_t i = 0; i < entities.size(); ++i) {
+    const Entity& e = entities[i];
+    mCellOf[i] = e.active ? cellAt(e.x + e.w / 2, e.y + e.h / 2) : -1;
+  }
+  scatter();
+}
+
+void SpatialGrid::build(const float* x, const float* y, const Uint8* active, int count) {
+  mCellOf.resize(count);
+  for (int i = 0; i < count; ++i) {
+    mCellOf[i] = active[i] ? cellAt(x[i], y[i]) : -1;
+  }
+  scatter();
+}
+
+void SpatialGrid::scatter() {
+  // Count the entities in each cell
+  std::fill(mCellStart.begin(), mCellStart.end(), 0);
+  for (int cell : mCellOf) {
+    if (cell >= 0) {
+      ++mCellStart[cell + 1];
+    }
+  }
+
+  // Turn the counts into start offsets, then scatter the indices
+  for (size_t c = 1; c < mCellStart.size(); ++c) {
+    mCellStart[c] += mCellStart[c - 1];
+  }
+  mItems.resize(mCellStart.back());
+  mCursor.assign(mCellStart.begin(), mCellStart.end() - 1);
+  for (size_t i = 0; i < mCellOf.size(); ++i) {
+    if (mCellOf[i] >= 0) {
+      mItems[mCursor[mCellOf[i]]++] = (int)i;
+    }
+  }
+}
+
+void SpatialGrid::query(float x, float y, float w, float h, std::vector<int>& out, FrameStats& stats) const {
+  int firstCol = (int)std::floor((x - mQueryMargin) / GRID_CELL_SIZE);
+  int firstRow = (int)std::floor((y - mQueryMargin) / GRID_CELL_SIZE);
+  int lastCol = std::min((int)std::floor((x + w + mQueryMargin) / GRID_CELL_SIZE), firstCol + GRID_COLS - 1);
+  int lastRow = std::min((int)std::floor((y + h + mQueryMargin) / GRID_CELL_SIZE), firstRow + GRID_ROWS - 1);
+
+  size_t before = out.size();
+  for (int row = firstRow; row <= lastRow; ++row) {
+    int rowStart = wrapIndex(row, GRID_ROWS) * GRID_COLS;
+    for (int col = firstCol; col <= lastCol; ++col) {
+      int cell = rowStart + wrapIndex(col, GRID_COLS);
+      out.insert(out.end(), mItems.begin() + mCellStart[cell], mItems.begin() + mCellStart[cell + 1]);
+    }
+  }
+
+  ++stats.queries;
+  stats.cellsVisited += (lastRow - firstRow + 1) * (lastCol - firstCol + 1);
+  stats.candidates += (int)(out.size() - before);
+}
+
+int SpatialGrid::gather(float x, float y, float radius, int* out, int maxOut) const {
+  // The point lies inside the sector, so offsetting by one world keeps the
+  // operands positive and truncation floors them; no cell is more than one
+  // world out, so a compare replaces the modulo
+  int firstCol = (int)((x - radius) / GRID_CELL_SIZE + GRID_COLS) - GRID_COLS;
+  int firstRow = (int)((y - radius) / GRID_CELL_SIZE + GRID_ROWS) - GRID_ROWS;
+  int lastCol = (int)((x + radius) / GRID_CELL_SIZE);
+  int lastRow = (int)((y + radius) / GRID_CELL_SIZE);
+  int found = 0;
+  for (int row = firstRow; row <= lastRow; ++row) {
+    int rowStart = (row < 0 ? row + GRID_ROWS : row >= GRID_ROWS ? row - GRID_ROWS : row) * GRID_COLS;
+    for (int col = firstCol; col <= lastCol; ++col) {
+      int cell = rowStart + (col < 0 ? col + GRID_COLS : col >= GRID_COLS ? col - GRID_COLS : col);
+      for (int item = mCellStart[cell]; item < mCellStart[cell + 1]; ++item) {
+        if (found == maxOut) {
+          return found;
+        }
+        out[found++] = mItems[item];
+      }
+    }
+  }
+  return found;
+}
+
+// Draws text in the built-in 3x5 font; all pixels go out in one fill call
+void drawText(int x, int y, const std::string& text, int scale) {
+  static std::vector<SDL_Rect> pixels;
+  pixels.clear();
+  for (size_t i = 0; i < text.size(); ++i) {
+    const char* glyph = strchr(FONT_CHARS, toupper((unsigned char)text[i]));
+    if (glyph == nullptr || text[i] == '\0') {
+      continue; // Spaces and unknown characters leave a gap
+    }
+    unsigned short bits = FONT_GLYPHS[glyph - FONT_CHARS];
+    for (int row = 0; row < 5; ++row) {
+      for (int col = 0; col < 3; ++col) {
+        if (bits & (1 << (14 - row * 3 - col))) {
+          pixels.push_back({x + (int)i * 4 * scale + col * scale, y + row * scale, scale, scale});
+        }
+      }
+    }
+  }
+  SDL_RenderFillRects(gRenderer, pixels.data(), (int)pixels.size());
+}
+
+// Draws the spatial query counters in the top-left corner
+void drawStats(const FrameStats& stats) {
+  char line[128];
+  SDL_SetRenderDrawColor(gRenderer, 0x00, 0xFF, 0x00, 0xFF);
+  snprintf(line, sizeof(line), "OBJECTS %d  DRAWN %d", (int)(gSwarm.size() + gAsteroids.size()), stats.drawn);
+  drawText(8, 8, line, 2);
+  snprintf(line, sizeof(line), "QUERIES %d  CELLS %d  CANDIDATES %d  TESTS %d", stats.queries, stats.cellsVisited, stats.candidates, stats.collisionTests);
+  drawText(8, 22, line, 2);
+  snprintf(line, sizeof(line), "FRAME %.2f MS  STARS %d IN %.3f MS", stats.frameMs, STAR_LAYERS * STARS_PER_LAYER, stats.starsMs);
+  drawText(8, 36, line, 2);
+  snprintf(line, sizeof(line), "RADAR %.3f MS", stats.radarMs);
+  drawText(8, 50, line, 2);
+  snprintf(line, sizeof(line), "SWARM %d ON %d THREADS IN %.3f MS  PARTS %d IN %.3f MS", gSwarm.size(), gWorkers.getThreadCount(), stats.enemiesMs,
+           (int)gStationParts.size(), stats.partsMs);
+  drawText(8, 64, line, 2);
+}
+
 // Main game loop
 int main(int argc, char* args[]) {
+  // Size the world population (--objects N, split between enemies and
+  // asteroids, and --stations N) and the swarm workers (--threads N)
+  int worldObjects = DEFAULT_WORLD_OBJECTS;
+  int threads = -1;
+  for (int i = 1; i + 1 < argc; ++i) {
+    if (strcmp(args[i], "--objects") == 0) {
+      worldObjects = std::max(0, atoi(args[i + 1]));
+    } else if (strcmp(args[i], "--stations") == 0) {
+      gStationCount = std::max(0, atoi(args[i + 1]));
+    } else if (strcmp(args[i], "--threads") == 0) {
+      threads = atoi(args[i + 1]);
+    }
+  }
+  gEnemyTarget = worldObjects / 2;
+  gAsteroidCount = worldObjects - gEnemyTarget;
+
   // Initialize SDL
   if (!init()) {
     std::cerr << "Failed to initialize!" << std::endl;
     return 1;
   }
 
+  // Start the swarm workers; the main thread makes one more
+  if (threads < 1) {
+    threads = SDL_GetCPUCount();
+  }
+  if (!gWorkers.start(std::min(threads - 1, MAX_WORKERS))) {
+    std::cerr << "Failed to start workers!" << std::endl;
+    return 1;
+  }
+
   // Load media
   if (!loadMedia()) {
     std::cerr << "Failed to load media!" << std::endl;
@@ -231,8 +1444,17 @@ int main(int argc, char* args[]) {
 
   // Game loop
   bool quit = false;
+  bool showStats = true;
+  FrameStats stats = {};
+  std::vector<int> nearby;
+  std::vector<SDL_Rect> asteroidRects;
   SDL_Event e;
   while (!quit) {
+    Uint64 frameStart = SDL_GetPerformanceCounter();
+    double lastFrameMs = stats.frameMs;
+    stats = {};
+    stats.frameMs = lastFrameMs;
+
     // Handle events
     while (SDL_PollEvent(&e) != 0) {
       if (e.type == SDL_QUIT) {
@@ -241,14 +1463,23 @@ int main(int argc, char* args[]) {
         switch (e.key.keysym.sym) {
           case SDLK_SPACE: { // Shoot bullet
             Entity bullet;
-            bullet.rect = {gPlayer.rect.x + PLAYER_WIDTH / 2 - BULLET_WIDTH / 2, gPlayer.rect.y + PLAYER_HEIGHT / 2 - BULLET_HEIGHT / 2, BULLET_WIDTH, BULLET_HEIGHT};
+            bullet.x = gPlayer.x + PLAYER_WIDTH / 2 - BULLET_WIDTH / 2;
+            bullet.y = gPlayer.y + PLAYER_HEIGHT / 2 - BULLET_HEIGHT / 2;
+            bullet.vx = (float)(BULLET_SPEED * cos(gPlayer.angle * M_PI / 180)); // Heading fixed at fire time
+            bullet.vy = (float)(-BULLET_SPEED * sin(gPlayer.angle * M_PI / 180));
+            bullet.w = BULLET_WIDTH;
+            bullet.h = BULLET_HEIGHT;
             bullet.angle = gPlayer.angle;
             bullet.speed = BULLET_SPEED;
             bullet.active = true;
+            bullet.radarCell = -1;
             gPlayerBullets.push_back(bullet);
-            Mix_PlayChannel(-1, gShootSound, 0);
+            Mix_PlayChannel(-1, gShootSound.get(), 0);
             break;
           }
+          case SDLK_F1: // Toggle the stats overlay
+            showStats = !showStats;
+            break;
         }
       }
     }
@@ -256,12 +1487,12 @@ int main(int argc, char* args[]) {
     // Handle continuous key presses
     const Uint8* currentKeyStates = SDL_GetKeyboardState(NULL);
     if (currentKeyStates[SDL_SCANCODE_UP]) {
-      gPlayer.rect.x += (int)(gPlayer.speed * cos(gPlayer.angle * M_PI / 180));
-      gPlayer.rect.y -= (int)(gPlayer.speed * sin(gPlayer.angle * M_PI / 180));
+      gPlayer.x += (float)(gPlayer.speed * cos(gPlayer.angle * M_PI / 180));
+      gPlayer.y -= (float)(gPlayer.speed * sin(gPlayer.angle * M_PI / 180));
     }
     if (currentKeyStates[SDL_SCANCODE_DOWN]) {
-      gPlayer.rect.x -= (int)(gPlayer.speed * cos(gPlayer.angle * M_PI / 180));
-      gPlayer.rect.y += (int)(gPlayer.speed * sin(gPlayer.angle * M_PI / 180));
+      gPlayer.x -= (float)(gPlayer.speed * cos(gPlayer.angle * M_PI / 180));
+      gPlayer.y += (float)(gPlayer.speed * sin(gPlayer.angle * M_PI / 180));
     }
     if (currentKeyStates[SDL_SCANCODE_LEFT]) {
       gPlayer.angle -= 5.0; // Adjust rotation speed as needed
@@ -270,89 +1501,230 @@ int main(int argc, char* args[]) {
       gPlayer.angle += 5.0;
     }
 
-    // Keep player within screen bounds
-    if (gPlayer.rect.x < 0) {
-      gPlayer.rect.x = 0;
-    } else if (gPlayer.rect.x > SCREEN_WIDTH - PLAYER_WIDTH) {
-      gPlayer.rect.x = SCREEN_WIDTH - PLAYER_WIDTH;
+    // Wrap the player around the sector and keep the camera centred on it
+    float previousCameraX = gCameraX;
+    float previousCameraY = gCameraY;
+    gPlayer.x = wrapCoordinate(gPlayer.x, WORLD_WIDTH);
+    gPlayer.y = wrapCoordinate(gPlayer.y, WORLD_HEIGHT);
+    gCameraX = wrapCoordinate(gPlayer.x + PLAYER_WIDTH / 2 - SCREEN_WIDTH / 2, WORLD_WIDTH);
+    gCameraY = wrapCoordinate(gPlayer.y + PLAYER_HEIGHT / 2 - SCREEN_HEIGHT / 2, WORLD_HEIGHT);
+    float cameraDeltaX = std::fmod(wrapDelta(gCameraX - previousCameraX, WORLD_WIDTH), (float)SCREEN_WIDTH);
+    float cameraDeltaY = std::fmod(wrapDelta(gCameraY - previousCameraY, WORLD_HEIGHT), (float)SCREEN_HEIGHT);
+
+    // Remove entities destroyed last frame (before the grids are rebuilt)
+    gSwarm.removeInactive();
+    gPlayerBullets.erase(std::remove_if(gPlayerBullets.begin(), gPlayerBullets.end(), [](const Entity& b) { return !b.active; }), gPlayerBullets.end());
+    if (gAsteroidsDirty) {
+      gAsteroids.erase(std::remove_if(gAsteroids.begin(), gAsteroids.end(), [](const Entity& a) { return !a.active; }), gAsteroids.end());
     }
-    if (gPlayer.rect.y < 0) {
-      gPlayer.rect.y = 0;
-    } else if (gPlayer.rect.y > SCREEN_HEIGHT - PLAYER_HEIGHT) {
-      gPlayer.rect.y = SCREEN_HEIGHT - PLAYER_HEIGHT;
+
+    // Generate new enemies out of view, one per frame up to the target
+    if (gSwarm.size() < gEnemyTarget) {
+      spawnEnemy();
     }
 
-    // Move enemy (example - you'll need more complex enemy AI)
-    for (auto& enemy : gEnemies) {
-      enemy.rect.x += enemy.speed;
-      if (enemy.rect.x + ENEMY_WIDTH > SCREEN_WIDTH || enemy.rect.x < 0) {
-        enemy.speed *= -1; // Change direction
-      }
+    // Steer the swarm against a grid of the current positions on every
+    // worker, then move it
+    Uint64 enemiesStart = SDL_GetPerformanceCounter();
+    gEnemyGrid.build(gSwarm.x.data(), gSwarm.y.data(), gSwarm.active.data(), gSwarm.size());
+    gWorkers.run(steerSwarm, gSwarm.size(), SWARM_CHUNK);
+    std::swap(gSwarm.vx, gSwarm.nextVx);
+    std::swap(gSwarm.vy, gSwarm.nextVy);
+    gWorkers.run(integrateSwarm, gSwarm.size(), SWARM_CHUNK);
+    for (int i = 0; i < gSwarm.size(); ++i) {
+      radarTrack(gSwarm.x[i], gSwarm.y[i], true, gSwarm.radarCell[i], gRadarEnemies);
     }
+    stats.enemiesMs = (SDL_GetPerformanceCounter() - enemiesStart) * 1000.0 / SDL_GetPerformanceFrequency();
 
-    // Move player bullets
+    // Spin the stations, then compose every part's transform in one pass.
+    // Stations turn in place, so their grid boxes never change.
+    Uint64 partsStart = SDL_GetPerformanceCounter();
+    for (int i = 0; i < (int)gStations.size(); ++i) {
+      gStationParts[i].localAngle = std::fmod(gStationParts[i].localAngle + STATION_SPIN, 360.0f);
+    }
+    updateParts(gStationParts);
+    stats.partsMs = (SDL_GetPerformanceCounter() - partsStart) * 1000.0 / SDL_GetPerformanceFrequency();
+
+    // Move player bullets; they expire once they leave the view
     for (auto& bullet : gPlayerBullets) {
-      bullet.rect.x += (int)(bullet.speed * cos(bullet.angle * M_PI / 180));
-      bullet.rect.y -= (int)(bullet.speed * sin(bullet.angle * M_PI / 180));
-      if (bullet.rect.x > SCREEN_WIDTH || bullet.rect.x < 0 || bullet.rect.y > SCREEN_HEIGHT || bullet.rect.y < 0) {
+      bullet.x = wrapCoordinate(bullet.x + bullet.vx, WORLD_WIDTH);
+      bullet.y = wrapCoordinate(bullet.y + bullet.vy, WORLD_HEIGHT);
+      SDL_Rect onScreen = screenRect(bullet);
+      if (onScreen.x > SCREEN_WIDTH || onScreen.x < 0 || onScreen.y > SCREEN_HEIGHT || onScreen.y < 0) {
         bullet.active = false;
       }
     }
 
-    // Check for collisions between bullets and enemies
+    // Rebuild the spatial grids (asteroids only change when one is destroyed)
+    gEnemyGrid.build(gSwarm.x.data(), gSwarm.y.data(), gSwarm.active.data(), gSwarm.size());
+    if (gAsteroidsDirty) {
+      gAsteroidGrid.build(gAsteroids);
+      gAsteroidsDirty = false;
+    }
+    if (gStationsDirty) {
+      gStationGrid.build(gStations);
+      gStationsDirty = false;
+    }
+
+    // Check for collisions between bullets and whatever the grids report nearby
     for (auto& bullet : gPlayerBullets) {
-      if (bullet.active) {
-        for (auto& enemy : gEnemies) {
-          if (enemy.active && SDL_HasIntersection(&bullet.rect, &enemy.rect)) {
-            enemy.active = false;
-            bullet.active = false;
-            gScore += 100;
-            Mix_PlayChannel(-1, gExplosionSound, 0);
-          }
+      if (!bullet.active) {
+        continue;
+      }
+      nearby.clear();
+      gEnemyGrid.query(bullet.x, bullet.y, bullet.w, bullet.h, nearby, stats);
+      for (int index : nearby) {
+        ++stats.collisionTests;
+        if (gSwarm.active[index] && swarmOverlap(bullet, index)) {
+          gSwarm.active[index] = 0;
+          radarTrack(gSwarm.x[index], gSwarm.y[index], false, gSwarm.radarCell[index], gRadarEnemies);
+          bullet.active = false;
+          gScore += 100;
+          Mix_PlayChannel(-1, gExplosionSound.get(), 0);
+          break;
+        }
+      }
+      if (!bullet.active) {
+        continue;
+      }
+      nearby.clear();
+      gStationGrid.query(bullet.x, bullet.y, bullet.w, bullet.h, nearby, stats);
+      for (int index : nearby) {
+        if (!gStations[index].active) {
+          continue;
+        }
+        int part = hitPart(gStationParts, index, bullet.x + bullet.w / 2, bullet.y + bullet.h / 2, BULLET_WIDTH / 2, stats);
+        if (part >= 0) {
+          gScore += damageStation(index, part);
+          bullet.active = false;
+          Mix_PlayChannel(-1, gExplosionSound.get(), 0);
+          break;
+        }
+      }
+      if (!bullet.active) {
+        continue;
+      }
+      nearby.clear();
+      gAsteroidGrid.query(bullet.x, bullet.y, bullet.w, bullet.h, nearby, stats);
+      for (int index : nearby) {
+        Entity& asteroid = gAsteroids[index];
+        ++stats.collisionTests;
+        if (asteroid.active && worldOverlap(bullet, asteroid)) {
+          asteroid.active = false;
+          radarTrack(asteroid, gRadarAsteroids);
+          bullet.active = false;
+          gAsteroidsDirty = true;
+          gScore += 10;
+          Mix_PlayChannel(-1, gExplosionSound.get(), 0);
+          break;
         }
       }
-    }
-
-    // Remove inactive entities
-    gEnemies.erase(std::remove_if(gEnemies.begin(), gEnemies.end(), [](const Entity& e) { return !e.active; }), gEnemies.end());
-    gPlayerBullets.erase(std::remove_if(gPlayerBullets.begin(), gPlayerBullets.end(), [](const Entity& b) { return !b.active; }), gPlayerBullets.end());
-
-    // Generate new enemies (adjust frequency as needed)
-    if (gEnemies.size() < 10) {
-      Entity enemy;
-      enemy.rect = {rand() % SCREEN_WIDTH, rand() % SCREEN_HEIGHT, ENEMY_WIDTH, ENEMY_HEIGHT};
-      enemy.texture = loadTexture("assets/enemy.png"); // Reload texture for new enemies
-      enemy.angle = 0.0;
-      enemy.speed = ENEMY_SPEED;
-      enemy.active = true;
-      gEnemies.push_back(enemy);
     }
 
     // Clear screen
     SDL_SetRenderDrawColor(gRenderer, 0x00, 0x00, 0x00, 0xFF);
     SDL_RenderClear(gRenderer);
 
-    // Render background
-    SDL_RenderCopy(gRenderer, gBackgroundTexture, nullptr, nullptr);
+    // Render background: scroll each starfield layer against the camera and
+    // draw it with a single points call
+    Uint64 starsStart = SDL_GetPerformanceCounter();
+    for (int layer = 0; layer < STAR_LAYERS; ++layer) {
+      std::vector<SDL_FPoint>& stars = gStars[layer];
+      scrollStars(stars.data(), (int)stars.size(), -cameraDeltaX * STAR_PARALLAX[layer], -cameraDeltaY * STAR_PARALLAX[layer]);
+      SDL_SetRenderDrawColor(gRenderer, STAR_COLORS[layer].r, STAR_COLORS[layer].g, STAR_COLORS[layer].b, STAR_COLORS[layer].a);
+      SDL_RenderDrawPointsF(gRenderer, stars.data(), (int)stars.size());
+    }
+    stats.starsMs = (SDL_GetPerformanceCounter() - starsStart) * 1000.0 / SDL_GetPerformanceFrequency();
+
+    // Render asteroids near the view in a single batch
+    SDL_Rect screen = {0, 0, SCREEN_WIDTH, SCREEN_HEIGHT};
+    nearby.clear();
+    gAsteroidGrid.query(gCameraX, gCameraY, SCREEN_WIDTH, SCREEN_HEIGHT, nearby, stats);
+    asteroidRects.clear();
+    for (int index : nearby) {
+      SDL_Rect rect = screenRect(gAsteroids[index]);
+      if (gAsteroids[index].active && SDL_HasIntersection(&rect, &screen)) {
+        asteroidRects.push_back(rect);
+      }
+    }
+    SDL_SetRenderDrawColor(gRenderer, 0x80, 0x70, 0x60, 0xFF);
+    SDL_RenderFillRects(gRenderer, asteroidRects.data(), (int)asteroidRects.size());
+    stats.drawn += (int)asteroidRects.size();
+
+    // Render stations near the view: the core, then its surviving pods
+    nearby.clear();
+    gStationGrid.query(gCameraX, gCameraY, SCREEN_WIDTH, SCREEN_HEIGHT, nearby, stats);
+    for (int index : nearby) {
+      SDL_Rect bounds = screenRect(gStations[index]);
+      if (!gStations[index].active || !SDL_HasIntersection(&bounds, &screen)) {
+        continue;
+      }
+      const Part& core = gStationParts[index];
+      SDL_Rect rect = partRect(core);
+      SDL_RenderCopyEx(gRenderer, gStationTexture.get(), nullptr, &rect, core.worldAngle, nullptr, SDL_FLIP_NONE);
+      ++stats.drawn;
+      for (int i = core.firstChild; i < core.firstChild + core.childCount; ++i) {
+        const Part& pod = gStationParts[i];
+        if (pod.active) {
+          rect = partRect(pod);
+          SDL_RenderCopyEx(gRenderer, gPodTexture.get(), &STATION_POD_CLIP, &rect, pod.worldAngle, nullptr, SDL_FLIP_NONE);
+          ++stats.drawn;
+        }
+      }
+    }
 
     // Render player
     if (gPlayer.active) {
-      SDL_RenderCopyEx(gRenderer, gPlayer.texture, nullptr, &gPlayer.rect, gPlayer.angle, nullptr, SDL_FLIP_NONE);
+      SDL_Rect rect = screenRect(gPlayer);
+      SDL_RenderCopyEx(gRenderer, gPlayer.texture.get(), nullptr, &rect, gPlayer.angle, nullptr, SDL_FLIP_NONE);
     }
 
-    // Render enemies
-    for (const auto& enemy : gEnemies) {
-      SDL_RenderCopy(gRenderer, enemy.texture, nullptr, &enemy.rect);
+    // Render enemies near the view
+    nearby.clear();
+    gEnemyGrid.query(gCameraX, gCameraY, SCREEN_WIDTH, SCREEN_HEIGHT, nearby, stats);
+    for (int index : nearby) {
+      SDL_Rect rect = {(int)std::floor(wrapDelta(gSwarm.x[index] - ENEMY_WIDTH / 2 - gCameraX, WORLD_WIDTH)),
+                       (int)std::floor(wrapDelta(gSwarm.y[index] - ENEMY_HEIGHT / 2 - gCameraY, WORLD_HEIGHT)), ENEMY_WIDTH, ENEMY_HEIGHT};
+      if (gSwarm.active[index] && SDL_HasIntersection(&rect, &screen)) {
+        SDL_RenderCopy(gRenderer, gEnemyTexture.get(), nullptr, &rect);
+        ++stats.drawn;
+      }
     }
 
     // Render bullets
     SDL_SetRenderDrawColor(gRenderer, 0xFF, 0xFF, 0x00, 0xFF); // Yellow color for bullets
     for (const auto& bullet : gPlayerBullets) {
-      SDL_RenderFillRect(gRenderer, &bullet.rect);
+      if (bullet.active) {
+        SDL_Rect rect = screenRect(bullet);
+        SDL_RenderFillRect(gRenderer, &rect);
+      }
     }
 
+    // Render the radar panel with the player and view marked on it
+    Uint64 radarStart = SDL_GetPerformanceCounter();
+    updateRadar();
+    SDL_Rect radarPanel = {SCREEN_WIDTH - RADAR_PANEL_WIDTH - 8, 8, RADAR_PANEL_WIDTH, RADAR_PANEL_HEIGHT};
+    SDL_RenderCopy(gRenderer, gRadarTexture, nullptr, &radarPanel);
+    SDL_Rect radarView = {radarPanel.x + (int)(gCameraX * RADAR_PANEL_WIDTH / WORLD_WIDTH), radarPanel.y + (int)(gCameraY * RADAR_PANEL_HEIGHT / WORLD_HEIGHT),
+                          SCREEN_WIDTH * RADAR_PANEL_WIDTH / WORLD_WIDTH, SCREEN_HEIGHT * RADAR_PANEL_HEIGHT / WORLD_HEIGHT};
+    SDL_SetRenderDrawColor(gRenderer, 0xFF, 0xFF, 0xFF, 0xFF);
+    SDL_RenderDrawRect(gRenderer, &radarView);
+    SDL_RenderDrawRect(gRenderer, &radarPanel);
+    int radarPlayerX = (int)(wrapCoordinate(gPlayer.x + gPlayer.w / 2, WORLD_WIDTH) * RADAR_PANEL_WIDTH / WORLD_WIDTH);
+    int radarPlayerY = (int)(wrapCoordinate(gPlayer.y + gPlayer.h / 2, WORLD_HEIGHT) * RADAR_PANEL_HEIGHT / WORLD_HEIGHT);
+    SDL_Rect radarPlayer = {radarPanel.x + radarPlayerX - 1, radarPanel.y + radarPlayerY - 1, 3, 3};
+    SDL_SetRenderDrawColor(gRenderer, 0xFF, 0xFF, 0x00, 0xFF);
+    SDL_RenderFillRect(gRenderer, &radarPlayer);
+    stats.radarMs = (SDL_GetPerformanceCounter() - radarStart) * 1000.0 / SDL_GetPerformanceFrequency();
+
     // Render score, etc.
     // (Implementation for rendering text using SDL_ttf is omitted for brevity)
+    if (showStats) {
+      drawStats(stats);
+    }
+
+    // Time the frame's CPU work, excluding the wait for vsync
+    stats.frameMs = (SDL_GetPerformanceCounter() - frameStart) * 1000.0 / SDL_GetPerformanceFrequency();
 
     // Update screen
     SDL_RenderPresent(gRenderer);
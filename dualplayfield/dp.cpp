@@ -1,9 +1,199 @@
 #include <SDL.h>
 #include <iostream>
+#include <vector>
+#include <unordered_map>
+#include <cstring>
+#include <algorithm>
 
 const int SCREEN_WIDTH = 1920;
 const int SCREEN_HEIGHT = 1080;
 
+// Playfield settings. Each layer image is cut into TILE_SIZE tiles when it
+// is loaded; identical tiles are stored once in the layer's tileset, and the
+// layer keeps a map of which tile goes where.
+const int TILE_SIZE = 16;
+const int TILESET_COLUMNS = 64;
+const Uint16 EMPTY_TILE = 0xFFFF;            // Fully see-through, never drawn
+const Uint32 TRANSPARENT_COLOR = 0xFFFF00FF; // Magenta is see-through on upper layers
+const int VISIBLE_COLUMNS = SCREEN_WIDTH / TILE_SIZE + 1; // Plus one for a partly scrolled tile
+const int STATS_INTERVAL = 300; // Frames between fill-rate reports
+
+// The layers, back to front, and their scrolling speeds in pixels per frame
+struct LayerConfig {
+  const char* file;
+  int speed;
+};
+const LayerConfig LAYERS[] = {
+  { "background.bmp", 2 },
+  { "foreground.bmp", 5 },
+};
+
+// A scrolling layer drawn from a tile map and a tileset. The map wraps
+// around horizontally.
+struct Layer {
+  const char* name;
+  int speed;
+  int scrollX;
+  int columns;
+  int rows;
+  std::vector<Uint16> map;      // Tile for each cell, row by row
+  SDL_Texture* tileset;
+  int tilesetWidth;
+  int tilesetHeight;
+  int tileCount;
+  std::vector<SDL_Vertex> vertices; // Visible tiles, rebuilt every frame
+  long long filledPixels;           // Drawn since the last report
+};
+
+// Cuts an image into tiles and builds a layer from them. Upper layers treat
+// TRANSPARENT_COLOR as see-through, and tiles with nothing left to show are
+// left out of the map altogether.
+bool loadLayer(SDL_Renderer* renderer, const LayerConfig& config, bool transparent, Layer& layer) {
+  SDL_Surface* loaded = SDL_LoadBMP(config.file);
+  if (loaded == nullptr) {
+    std::cerr << "Unable to load " << config.file << "! SDL_Error: " << SDL_GetError() << std::endl;
+    return false;
+  }
+  SDL_Surface* image = SDL_ConvertSurfaceFormat(loaded, SDL_PIXELFORMAT_ARGB8888, 0);
+  SDL_FreeSurface(loaded);
+  if (image == nullptr) {
+    std::cerr << "Unable to convert " << config.file << "! SDL_Error: " << SDL_GetError() << std::endl;
+    return false;
+  }
+
+  layer.name = config.file;
+  layer.speed = config.speed;
+  layer.scrollX = 0;
+  layer.columns = (image->w + TILE_SIZE - 1) / TILE_SIZE;
+  layer.rows = (image->h + TILE_SIZE - 1) / TILE_SIZE;
+  layer.map.assign(layer.columns * layer.rows, EMPTY_TILE);
+  layer.filledPixels = 0;
+
+  // Unique tiles, found by hashing each tile's pixels
+  std::vector<Uint32> tiles;
+  std::unordered_multimap<Uint32, int> tilesByHash;
+  Uint32 tile[TILE_SIZE * TILE_SIZE];
+  for (int row = 0; row < layer.rows; ++row) {
+    for (int column = 0; column < layer.columns; ++column) {
+      bool empty = true;
+      Uint32 hash = 2166136261u;
+      for (int y = 0; y < TILE_SIZE; ++y) {
+        int imageY = row * TILE_SIZE + y;
+        for (int x = 0; x < TILE_SIZE; ++x) {
+          int imageX = column * TILE_SIZE + x;
+          // Edge tiles are padded with see-through, or black on the bottom layer
+          Uint32 pixel = transparent ? 0 : 0xFF000000;
+          if (imageX < image->w && imageY < image->h) {
+            pixel = ((Uint32*)((Uint8*)image->pixels + imageY * image->pitch))[imageX];
+            if (transparent && pixel == TRANSPARENT_COLOR) {
+              pixel = 0;
+            }
+          }
+          empty = empty && pixel == 0;
+          tile[y * TILE_SIZE + x] = pixel;
+          hash = (hash ^ pixel) * 16777619u;
+        }
+      }
+      if (empty) {
+        continue;
+      }
+
+      int index = -1;
+      auto range = tilesByHash.equal_range(hash);
+      for (auto it = range.first; it != range.second && index < 0; ++it) {
+        if (memcmp(&tiles[it->second * TILE_SIZE * TILE_SIZE], tile, sizeof(tile)) == 0) {
+          index = it->second;
+        }
+      }
+      if (index < 0) {
+        index = (int)(tiles.size() / (TILE_SIZE * TILE_SIZE));
+        if (index == EMPTY_TILE) {
+          std::cerr << config.file << " has too many different tiles!" << std::endl;
+          SDL_FreeSurface(image);
+          return false;
+        }
+        tiles.insert(tiles.end(), tile, tile + TILE_SIZE * TILE_SIZE);
+        tilesByHash.insert({ hash, index });
+      }
+      layer.map[row * layer.columns + column] = (Uint16)index;
+    }
+  }
+  int imageBytes = image->w * image->h * 4;
+  SDL_FreeSurface(image);
+
+  // Lay the unique tiles out in a grid in the tileset texture
+  layer.tileCount = (int)(tiles.size() / (TILE_SIZE * TILE_SIZE));
+  layer.tilesetWidth = std::max(std::min(layer.tileCount, TILESET_COLUMNS), 1) * TILE_SIZE;
+  layer.tilesetHeight = std::max((layer.tileCount + TILESET_COLUMNS - 1) / TILESET_COLUMNS, 1) * TILE_SIZE;
+  SDL_Surface* tileset = SDL_CreateRGBSurfaceWithFormat(0, layer.tilesetWidth, layer.tilesetHeight, 32, SDL_PIXELFORMAT_ARGB8888);
+  if (tileset == nullptr) {
+    std::cerr << "Unable to create tileset for " << config.file << "! SDL_Error: " << SDL_GetError() << std::endl;
+    return false;
+  }
+  for (int index = 0; index < layer.tileCount; ++index) {
+    int tileX = index % TILESET_COLUMNS * TILE_SIZE;
+    int tileY = index / TILESET_COLUMNS * TILE_SIZE;
+    for (int y = 0; y < TILE_SIZE; ++y) {
+      Uint32* row = (Uint32*)((Uint8*)tileset->pixels + (tileY + y) * tileset->pitch) + tileX;
+      memcpy(row, &tiles[(index * TILE_SIZE + y) * TILE_SIZE], TILE_SIZE * sizeof(Uint32));
+    }
+  }
+  layer.tileset = SDL_CreateTextureFromSurface(renderer, tileset);
+  SDL_FreeSurface(tileset);
+  if (layer.tileset == nullptr) {
+    std::cerr << "Unable to create tileset texture for " << config.file << "! SDL_Error: " << SDL_GetError() << std::endl;
+    return false;
+  }
+  // The bottom layer covers the screen, so it need not be blended
+  SDL_SetTextureBlendMode(layer.tileset, transparent ? SDL_BLENDMODE_BLEND : SDL_BLENDMODE_NONE);
+
+  layer.vertices.reserve(VISIBLE_COLUMNS * layer.rows * 4);
+  std::cout << layer.name << ": " << layer.columns << "x" << layer.rows << " tiles, " << layer.tileCount
+            << " unique, texture memory " << layer.tilesetWidth * layer.tilesetHeight * 4 << " bytes (was "
+            << imageBytes << " as a full bitmap), map " << layer.map.size() * sizeof(Uint16) << " bytes" << std::endl;
+  return true;
+}
+
+// Draws the tiles of a layer that are on screen in a single batch, and adds
+// the pixels they cover to the layer's fill count
+void drawLayer(SDL_Renderer* renderer, Layer& layer, const std::vector<int>& quadIndices) {
+  int firstColumn = layer.scrollX / TILE_SIZE;
+  int offsetX = -(layer.scrollX % TILE_SIZE);
+  int rows = std::min(layer.rows, (SCREEN_HEIGHT + TILE_SIZE - 1) / TILE_SIZE);
+  int columns = std::min(VISIBLE_COLUMNS, (SCREEN_WIDTH - offsetX + TILE_SIZE - 1) / TILE_SIZE);
+  float tileU = (float)TILE_SIZE / layer.tilesetWidth;
+  float tileV = (float)TILE_SIZE / layer.tilesetHeight;
+  SDL_Color white = { 0xFF, 0xFF, 0xFF, 0xFF };
+
+  layer.vertices.clear();
+  for (int row = 0; row < rows; ++row) {
+    const Uint16* mapRow = &layer.map[row * layer.columns];
+    float top = (float)(row * TILE_SIZE);
+    float bottom = top + TILE_SIZE;
+    int visibleHeight = std::min(SCREEN_HEIGHT - row * TILE_SIZE, TILE_SIZE);
+    for (int column = 0; column < columns; ++column) {
+      Uint16 tile = mapRow[(firstColumn + column) % layer.columns];
+      if (tile == EMPTY_TILE) {
+        continue;
+      }
+      int x = offsetX + column * TILE_SIZE;
+      float left = (float)x;
+      float right = left + TILE_SIZE;
+      float u = (tile % TILESET_COLUMNS) * tileU;
+      float v = (tile / TILESET_COLUMNS) * tileV;
+      layer.vertices.push_back({ { left, top }, white, { u, v } });
+      layer.vertices.push_back({ { right, top }, white, { u + tileU, v } });
+      layer.vertices.push_back({ { left, bottom }, white, { u, v + tileV } });
+      layer.vertices.push_back({ { right, bottom }, white, { u + tileU, v + tileV } });
+      layer.filledPixels += (std::min(x + TILE_SIZE, SCREEN_WIDTH) - std::max(x, 0)) * visibleHeight;
+    }
+  }
+  int quads = (int)layer.vertices.size() / 4;
+  if (quads > 0) {
+    SDL_RenderGeometry(renderer, layer.tileset, layer.vertices.data(), quads * 4, quadIndices.data(), quads * 6);
+  }
+}
+
 int main(int argc, char* argv[]) {
   // Initialize SDL
   if (SDL_Init(SDL_INIT_VIDEO) < 0) {
@@ -25,34 +215,31 @@ int main(int argc, char* argv[]) {
     return 1;
   }
 
-  // Load background and foreground images
-  SDL_Surface* backgroundSurface = SDL_LoadBMP("background.bmp");
-  if (backgroundSurface == nullptr) {
-    std::cerr << "Unable to load background image! SDL_Error: " << SDL_GetError() << std::endl;
-    return 1;
+  // Load the layers as tile maps
+  std::vector<Layer> layers(sizeof(LAYERS) / sizeof(LAYERS[0]));
+  for (size_t i = 0; i < layers.size(); ++i) {
+    if (!loadLayer(renderer, LAYERS[i], i > 0, layers[i])) {
+      return 1;
+    }
   }
-  SDL_Texture* backgroundTexture = SDL_CreateTextureFromSurface(renderer, backgroundSurface);
-  SDL_FreeSurface(backgroundSurface);
 
-  SDL_Surface* foregroundSurface = SDL_LoadBMP("foreground.bmp");
-  if (foregroundSurface == nullptr) {
-    std::cerr << "Unable to load foreground image! SDL_Error: " << SDL_GetError() << std::endl;
-    return 1;
+  // Two triangles per tile, shared by every layer
+  int maxRows = 0;
+  for (const Layer& layer : layers) {
+    maxRows = std::max(maxRows, layer.rows);
+  }
+  std::vector<int> quadIndices;
+  for (int quad = 0; quad < VISIBLE_COLUMNS * maxRows; ++quad) {
+    int corners[] = { 0, 1, 2, 2, 1, 3 };
+    for (int corner : corners) {
+      quadIndices.push_back(quad * 4 + corner);
+    }
   }
-  SDL_Texture* foregroundTexture = SDL_CreateTextureFromSurface(renderer, foregroundSurface);
-  SDL_FreeSurface(foregroundSurface);
-
-  // Scrolling offsets
-  int backgroundX = 0;
-  int foregroundX = 0;
-
-  // Scrolling speeds
-  int backgroundSpeed = 2;
-  int foregroundSpeed = 5;
 
   // Game loop
   bool quit = false;
   SDL_Event e;
+  int frames = 0;
   while (!quit) {
     // Handle events on queue
     while (SDL_PollEvent(&e) != 0) {
@@ -61,43 +248,41 @@ int main(int argc, char* argv[]) {
       }
     }
 
-    // Update scrolling offsets
-    backgroundX -= backgroundSpeed;
-    foregroundX -= foregroundSpeed;
-
-    // Reset offsets when images scroll off screen
-    if (backgroundX <= -SCREEN_WIDTH) {
-      backgroundX = 0;
-    }
-    if (foregroundX <= -SCREEN_WIDTH) {
-      foregroundX = 0;
+    // Update scrolling offsets, wrapping at the width of each layer's map
+    for (Layer& layer : layers) {
+      layer.scrollX = (layer.scrollX + layer.speed) % (layer.columns * TILE_SIZE);
     }
 
     // Clear screen
     SDL_RenderClear(renderer);
 
-    // Render background
-    SDL_Rect backgroundRect = { backgroundX, 0, SCREEN_WIDTH, SCREEN_HEIGHT };
-    SDL_RenderCopy(renderer, backgroundTexture, NULL, &backgroundRect);
-    SDL_Rect backgroundRect2 = { backgroundX + SCREEN_WIDTH, 0, SCREEN_WIDTH, SCREEN_HEIGHT }; // Second copy for continuous scrolling
-    SDL_RenderCopy(renderer, backgroundTexture, NULL, &backgroundRect2);
-
-    // Render foreground
-    SDL_Rect foregroundRect = { foregroundX, 0, SCREEN_WIDTH, SCREEN_HEIGHT };
-    SDL_RenderCopy(renderer, foregroundTexture, NULL, &foregroundRect);
-    SDL_Rect foregroundRect2 = { foregroundX + SCREEN_WIDTH, 0, SCREEN_WIDTH, SCREEN_HEIGHT }; // Second copy for continuous scrolling
-    SDL_RenderCopy(renderer, foregroundTexture, NULL, &foregroundRect2);
+    // Render the layers back to front
+    for (Layer& layer : layers) {
+      drawLayer(renderer, layer, quadIndices);
+    }
 
     // Update screen
     SDL_RenderPresent(renderer);
 
+    // Report how much each layer draws, as a share of the screen
+    if (++frames % STATS_INTERVAL == 0) {
+      for (Layer& layer : layers) {
+        double perFrame = (double)layer.filledPixels / STATS_INTERVAL;
+        std::cout << layer.name << ": " << perFrame / 1e6 << " Mpixels per frame ("
+                  << perFrame / (SCREEN_WIDTH * SCREEN_HEIGHT) << " screens), texture memory "
+                  << layer.tilesetWidth * layer.tilesetHeight * 4 << " bytes" << std::endl;
+        layer.filledPixels = 0;
+      }
+    }
+
     // Cap the frame rate
     SDL_Delay(16); // Approximately 60 FPS
   }
 
   // Destroy textures
-  SDL_DestroyTexture(backgroundTexture);
-  SDL_DestroyTexture(foregroundTexture);
+  for (Layer& layer : layers) {
+    SDL_DestroyTexture(layer.tileset);
+  }
 
   // Destroy renderer and window
   SDL_DestroyRenderer(renderer);
@@ -1,37 +1,137 @@
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_image.h>
 #include <SDL2/SDL_mixer.h>
+#include <SDL2/SDL_net.h>
 #include <iostream>
 #include <vector>
 #include <cmath>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <algorithm>
+#include <random>
+#include <climits>
+#include <deque>
+#include <type_traits>
 
 // Screen dimensions
 const int SCREEN_WIDTH = 640;
 const int SCREEN_HEIGHT = 480;
 
-// Player tank settings
+// Player tank settings (speeds are in pixels per second)
 const int TANK_WIDTH = 40;
 const int TANK_HEIGHT = 30;
-const int TANK_SPEED = 5;
+const float TANK_SPEED = 300.0f;
 
 // Enemy tank settings
 const int ENEMY_TANK_WIDTH = 30;
 const int ENEMY_TANK_HEIGHT = 20;
-const int ENEMY_TANK_SPEED = 3;
+const float ENEMY_TANK_SPEED = 180.0f;
+const int ENEMY_SIGHT_RANGE = 400;
+const float ENEMY_RELOAD_TIME = 1.0f;  // Seconds
+const int DEFAULT_ENEMY_COUNT = 8;
+
+// Job system settings (enemy tanks planned per job)
+const int ENEMY_CHUNK = 16;
 
 // Bullet settings
-const int BULLET_SPEED = 10;
+const float BULLET_SPEED = 600.0f;
+
+// Simulation settings: fixed ticks per second, and the longest frame (in
+// seconds) the simulation catches up on before it drops time
+const int DEFAULT_SIM_HZ = 120;
+const double MAX_FRAME_TIME = 0.25;
+
+// Rotation settings (sprites are pre-rotated into ROTATION_STEPS frames)
+const int ROTATION_STEPS = 72;
+const int ROTATION_STEP_DEGREES = 360 / ROTATION_STEPS;
+
+// Fixed-point trigonometry settings (Q14 sin/cos, one entry per degree)
+const int TRIG_SHIFT = 14;
+const int TRIG_ONE = 1 << TRIG_SHIFT;
+const int ATAN_TABLE_SIZE = 256;
+
+// Wall tree settings (walls per leaf of the AABB tree)
+const int WALL_LEAF_SIZE = 4;
+
+// Versus mode settings (player N listens on VERSUS_PORT + N)
+const int VERSUS_PORT = 7000;
+const int VERSUS_MAX_BULLETS = 32;
+const int VERSUS_RELOAD_FRAMES = 20;
+const int VERSUS_TICK_MS = 16;
+const float VERSUS_DT = VERSUS_TICK_MS / 1000.0f;
+
+// Rollback settings: frames of snapshots and inputs kept, and how far a
+// peer may run ahead of the last remote input it has
+const int ROLLBACK_HISTORY = 64;
+const int ROLLBACK_MAX_PREDICTION = 12;
+const int ROLLBACK_PACKET_SIZE = 256;
+
+// Versus input bits, one byte per player per frame
+const Uint8 INPUT_UP = 1 << 0;
+const Uint8 INPUT_DOWN = 1 << 1;
+const Uint8 INPUT_LEFT = 1 << 2;
+const Uint8 INPUT_RIGHT = 1 << 3;
+const Uint8 INPUT_FIRE = 1 << 4;
+
+// Sprite cache settings (cache files sit next to their images)
+const Uint32 TEXTURE_CACHE_MAGIC = 0x32435854;  // "TXC2"
+const char* const TEXTURE_CACHE_SUFFIX = ".cache";
+
+// Header of a sprite cache file. The pixels follow it, premultiplied by
+// alpha and in the renderer's texture format, so they upload as they are.
+struct TextureCacheHeader {
+    Uint32 magic;
+    Uint32 format;                   // SDL pixel format of the pixels
+    Sint32 width, height;            // Of the pixels, in rows of width * 4 bytes
+    Sint32 imageWidth, imageHeight;  // Of the sprite as drawn
+    Uint32 sourceHash;               // hashFile of the image it was made from
+    Uint32 checksum;                 // Of the pixels
+};
+
+// Oriented bounding box: centre, unit axis along the heading and half
+// extents along (hx) and across (hy) that axis
+struct OBB {
+    float cx, cy;
+    float ux, uy;
+    float hx, hy;
+};
 
 // Function declarations
 bool init();
 bool loadMedia();
 void close();
 bool checkCollision(SDL_Rect a, SDL_Rect b);
+bool checkCollision(const OBB& a, const OBB& b);
+Uint32 hashFile(const std::string& path);
+Uint32 checksumPixels(const Uint8* pixels, size_t size);
+OBB makeOBB(float cx, float cy, int heading, float length, float width);
+void initTrigTables();
+int fixedSin(int degrees);
+int fixedCos(int degrees);
+int lutAtan2(int y, int x);
+void benchmarkRotation();
+std::vector<SDL_Rect> loadWalls(const std::string& path);
+void benchmarkWalls(const char* path);
+void benchmarkAI(int tanks);
+void benchmarkSAT();
+void benchmarkRollback();
+void runVersus(int player, const char* host, int loss);
+void runHeadless(double seconds, int simHz, int threads, int enemyCount);
+
+// Trigonometry lookup tables
+int gSinTable[360];                   // sin of each whole degree, Q14
+int gAtanTable[ATAN_TABLE_SIZE + 1];  // atan(i / ATAN_TABLE_SIZE) in whole degrees
 
 // SDL objects
 SDL_Window* gWindow = nullptr;
 SDL_Renderer* gRenderer = nullptr;
 
+// The renderer's texture format and blend mode for premultiplied sprites
+Uint32 gTextureFormat = SDL_PIXELFORMAT_ARGB8888;
+SDL_BlendMode gPremultipliedBlend = SDL_BLENDMODE_BLEND;
+
 // Texture wrapper class
 class LTexture {
 public:
@@ -39,8 +139,32 @@ public:
     ~LTexture();
 
     bool loadFromFile(std::string path);
+
+    // Loads an image and pre-rotates it into a sheet of frames, one per
+    // 360 / frames degrees, so rendering at an angle is a straight copy
+    bool loadRotationSheet(std::string path, int frames);
+
+    // Reads a sprite cache file in a single read, checking that it is whole
+    // and was made from a source image of the given size
+    static bool readCache(std::string path, Uint32 sourceHash, std::vector<Uint8>& cache);
+
+    // Converts a color-keyed image or sheet into sprite cache data; the
+    // image size is what the sprite is drawn at
+    static bool buildCache(SDL_Surface* surface, int imageWidth, int imageHeight, Uint32 sourceHash, std::vector<Uint8>& cache);
+
+    // Saves sprite cache data
+    static bool writeCache(std::string path, const std::vector<Uint8>& cache);
+
+    // Uploads sprite cache data with no conversion
+    bool loadFromCache(const std::vector<Uint8>& cache, std::string path);
+
     void free();
+    void setColor(Uint8 red, Uint8 green, Uint8 blue);
     void render(int x, int y, SDL_Rect* clip = nullptr, double angle = 0.0, SDL_Point* center = nullptr, SDL_RendererFlip flip = SDL_FLIP_NONE);
+
+    // Renders the sheet frame nearest to the angle, centred where render(x, y) puts the image
+    void renderRotated(int x, int y, int degrees);
+
     int getWidth();
     int getHeight();
 
@@ -48,6 +172,147 @@ private:
     SDL_Texture* mTexture;
     int mWidth;
     int mHeight;
+
+    // Rotation sheet layout (no frames for a plain texture)
+    int mFrames;
+    int mFrameSize;
+    int mColumns;
+};
+
+// Static AABB tree over the level's walls. It is bulk-built once by median
+// splits into a flat node array in depth-first order, so a node's left child
+// directly follows it.
+class AABBTree {
+public:
+    // Builds the tree over the given walls, replacing any previous build
+    void build(const std::vector<SDL_Rect>& walls);
+
+    // Appends the indices of walls overlapping the box
+    void query(const SDL_Rect& box, std::vector<int>& out) const;
+
+    // Returns the fraction of the move (dx, dy) the box can make before it
+    // touches a wall, 1 when the path is clear. Walls the box already
+    // overlaps are ignored, so it can always back out of them.
+    float sweep(const SDL_Rect& box, float dx, float dy) const;
+
+    // Whether the segment between two points crosses no wall
+    bool lineOfSight(int x0, int y0, int x1, int y1) const { return sweep({ x0, y0, 0, 0 }, (float)(x1 - x0), (float)(y1 - y0)) >= 1.0f; }
+
+    // Gets a wall by index
+    const SDL_Rect& getWall(int index) const { return mWalls[index]; }
+
+    // Gets the number of walls
+    int size() const { return (int)mWalls.size(); }
+
+private:
+    // Node bounds are inclusive-exclusive; leaves hold count > 0 walls
+    // starting at first, inner nodes have count 0 and their right child at first
+    struct Node {
+        int minX, minY, maxX, maxY;
+        int first;
+        int count;
+    };
+
+    // Builds the subtree over mOrder[first, first + count)
+    void buildNode(int first, int count);
+
+    std::vector<Node> mNodes;
+    std::vector<int> mOrder; // Wall indices, grouped by leaf
+    std::vector<SDL_Rect> mWalls;
+};
+
+// Work-stealing job system. Each worker owns a deque: it pops its own jobs
+// from the back and, once that is empty, steals from the front of the
+// others'. The thread that calls parallelFor joins in as worker 0 and
+// returns once every job has finished.
+class JobSystem {
+public:
+    typedef void (*JobFunc)(void* data, int begin, int end);
+
+    // Starts threads - 1 workers to go with the calling thread
+    explicit JobSystem(int threads);
+    ~JobSystem();
+
+    // Runs func over [0, count) in jobs of up to chunk items
+    void parallelFor(int count, int chunk, JobFunc func, void* data);
+
+    // Gets the number of threads, including the caller
+    int getThreadCount() const { return (int)mQueues.size(); }
+
+private:
+    struct Job {
+        JobFunc func;
+        void* data;
+        int begin;
+        int end;
+    };
+
+    struct Queue {
+        SDL_mutex* lock;
+        std::deque<Job> jobs;
+    };
+
+    struct Worker {
+        JobSystem* system;
+        int index;
+    };
+
+    static int threadMain(void* data);
+
+    // Takes a job from the worker's own deque, or steals one
+    bool findJob(int worker, Job& job);
+
+    // Runs jobs until there are none left to take
+    void runJobs(int worker);
+
+    std::vector<Queue> mQueues;
+    std::vector<Worker> mWorkers;
+    std::vector<SDL_Thread*> mThreads;
+    SDL_sem* mWake;
+    SDL_atomic_t mPending; // Jobs queued or running
+    SDL_atomic_t mQuit;
+};
+
+// Many oriented boxes stored as parallel arrays, each with the half size of
+// its axis-aligned bounds cached for the pre-pass. The kernels test one box
+// against the whole set without branching per pair.
+class OBBSet {
+public:
+    // Removes every box
+    void clear();
+
+    // Adds a box
+    void add(const OBB& box);
+
+    // Gets the number of boxes
+    int size() const { return (int)mCX.size(); }
+
+    // Pre-pass: writes the indices of boxes whose bounds overlap the box's
+    // bounds to out, returning the count. out must hold size() entries.
+    int overlapBounds(const OBB& box, int* out) const;
+
+    // Narrow phase: separating-axis test of the box against the listed
+    // candidates; writes the overlapping ones to out, returning the count
+    int overlapBoxes(const OBB& box, const int* candidates, int count, int* out) const;
+
+    // Both phases; appends the indices of overlapping boxes to out
+    void overlaps(const OBB& box, std::vector<int>& out) const;
+
+private:
+    std::vector<float> mCX, mCY, mUX, mUY, mHX, mHY;
+    std::vector<float> mEX, mEY; // Half size of each box's bounds
+    mutable std::vector<int> mCandidates;
+    mutable std::vector<int> mHits;
+};
+
+// What an enemy tank decided to do in one tick
+struct EnemyOrder {
+    float posX, posY;  // New position
+    int heading;
+    int goalX, goalY;  // Where it is heading for
+    bool hasGoal;
+    int target;        // Index of the target in sight, -1 if none
+    bool fire;
 };
 
 // The player-controlled tank
@@ -55,28 +320,46 @@ class Tank {
 public:
     // Initializes the variables
     Tank();
+    Tank(int x, int y, int heading);
 
     // Takes key presses and adjusts the tank's velocity
     void handleEvent(SDL_Event& e);
 
-    // Moves the tank
-    void move(std::vector<SDL_Rect>& colliders);
+    // Sets the velocity and turns the tank from one frame of versus input
+    void applyInput(Uint8 input);
 
-    // Shows the tank on the screen
-    void render();
+    // Moves the tank for dt seconds, sliding along any walls in the way
+    void move(const AABBTree& walls, float dt);
+
+    // Shows the tank on the screen, alpha of the way from where it was
+    // before its last move to where it is now
+    void render(float alpha = 1.0f) const;
 
     // Gets the collision box
     SDL_Rect getCollider() const;  // Marked as const
 
+    // Gets the rotated hull
+    OBB getHull() const;
+
+    // Gets the heading in whole degrees
+    int getHeading() const { return mHeading; }
+
 private:
-    // The X and Y offsets of the tank
-    int mPosX, mPosY;
+    // Points the velocity along the heading, by the throttle
+    void updateVelocity();
+
+    // The X and Y offsets of the tank, now and before its last move
+    float mPosX, mPosY;
+    float mPrevX, mPrevY;
 
     // The velocity of the tank
-    int mVelX, mVelY;
+    float mVelX, mVelY;
 
-    // The angle of the tank
-    double mAngle;
+    // Forward (1), reverse (-1) or stopped (0)
+    int mThrottle;
+
+    // The heading of the tank in degrees, a multiple of ROTATION_STEP_DEGREES
+    int mHeading;
 
     // Collision box of the tank
     SDL_Rect mCollider;
@@ -89,17 +372,23 @@ public:
     static const int BULLET_WIDTH = 5;
     static const int BULLET_HEIGHT = 10;
 
-    // Initializes the variables
-    Bullet(int x, int y, double angle);
+    // Initializes the variables (heading in whole degrees)
+    Bullet(float x, float y, int heading);
 
-    // Moves the bullet
-    void move();
+    // Initializes an inactive bullet
+    Bullet();
 
-    // Shows the bullet on the screen
-    void render();
+    // Moves the bullet for dt seconds
+    void move(float dt);
+
+    // Shows the bullet on the screen, alpha of the way through its last move
+    void render(float alpha = 1.0f) const;
 
     // Gets the collision box
-    SDL_Rect getCollider();
+    SDL_Rect getCollider() const;
+
+    // Gets the rotated hull, long side along the flight path
+    OBB getHull() const;
 
     // Whether the bullet is active
     bool isActive() const { return active; }
@@ -108,11 +397,15 @@ public:
     void setActive(bool active) { this->active = active; }
 
 private:
-    // The X and Y offsets of the bullet
-    int mPosX, mPosY;
+    // The X and Y offsets of the bullet, now and before its last move
+    float mPosX, mPosY;
+    float mPrevX, mPrevY;
 
     // The velocity of the bullet
-    int mVelX, mVelY;
+    float mVelX, mVelY;
+
+    // The heading of the bullet in whole degrees
+    int mHeading;
 
     // Collision box of the bullet
     SDL_Rect mCollider;
@@ -127,14 +420,24 @@ public:
     // Initializes the variables
     EnemyTank(int x, int y);
 
-    // Moves the enemy tank
-    void move(const Tank& player);
+    // Decides the next dt seconds' move from the targets (tank centres) and
+    // walls. It changes nothing, so many tanks can plan at once.
+    EnemyOrder plan(const std::vector<SDL_Point>& targets, const AABBTree& walls, float dt) const;
+
+    // Carries out a planned move
+    void apply(const EnemyOrder& order, float dt);
 
-    // Shows the enemy tank on the screen
-    void render();
+    // Shows the enemy tank on the screen, alpha of the way through its last move
+    void render(float alpha = 1.0f) const;
 
     // Gets the collision box
-    SDL_Rect getCollider();
+    SDL_Rect getCollider() const;
+
+    // Gets the heading in whole degrees
+    int getHeading() const { return mHeading; }
+
+    // Gets the rotated hull
+    OBB getHull() const;
 
     // Whether the enemy tank is alive
     bool isAlive() const { return alive; }
@@ -143,14 +446,19 @@ public:
     void setAlive(bool alive) { this->alive = alive; }
 
 private:
-    // The X and Y offsets of the enemy tank
-    int mPosX, mPosY;
+    // The X and Y offsets of the enemy tank, now and before its last move
+    float mPosX, mPosY;
+    float mPrevX, mPrevY;
 
-    // The velocity of the enemy tank
-    int mVelX, mVelY;
+    // The heading of the enemy tank in whole degrees
+    int mHeading;
 
-    // The angle of the enemy tank
-    double mAngle;
+    // Where the tank is heading for (its target, or where it was last seen)
+    int mGoalX, mGoalY;
+    bool mHasGoal;
+
+    // Seconds until the tank can fire again
+    float mReload;
 
     // Collision box of the enemy tank
     SDL_Rect mCollider;
@@ -159,6 +467,178 @@ private:
     bool alive;
 };
 
+// Everything planEnemies needs, shared by all of its jobs
+struct EnemyPlanJob {
+    const std::vector<EnemyTank>* enemies;
+    const std::vector<SDL_Point>* targets;
+    const AABBTree* walls;
+    std::vector<EnemyOrder>* orders;
+    float dt;
+};
+
+// The whole versus game state. It holds no pointers, so a snapshot or a
+// restore is a single memcpy.
+struct VersusState {
+    int frame;
+    Tank tanks[2];
+    int reload[2];
+    int score[2];
+    Bullet bullets[VERSUS_MAX_BULLETS];
+    int bulletOwner[VERSUS_MAX_BULLETS];
+    int bulletCount;
+};
+
+static_assert(std::is_trivially_copyable<VersusState>::value, "VersusState must be memcpy-able");
+
+// What rollback cost over a session
+struct RollbackStats {
+    int rollbacks;     // Times a late input differed from its prediction
+    int resimFrames;   // Frames simulated again because of them
+    int maxDepth;      // Most frames re-simulated at once
+    int stalls;        // Ticks spent waiting for the remote peer
+    double resimMs;    // Time spent restoring and re-simulating
+};
+
+// Rollback netcode for versus mode. Each peer sends the remote one every
+// input it has not acknowledged, over UDP, and runs ahead on a prediction
+// of the remote input (the last one it heard). When a real input turns out
+// to differ from the prediction, the snapshot from that frame is restored
+// and the game re-simulated up to the present.
+class RollbackSession {
+public:
+    RollbackSession(int localPlayer, const AABBTree& walls);
+    ~RollbackSession();
+
+    // Opens this player's socket and aims it at the other player on host
+    bool connect(const char* host);
+
+    // Drops this percentage of outgoing packets, to test on loopback
+    void setLoss(int percent) { mLoss = percent; }
+
+    // Takes in remote inputs, rolls back if any were mispredicted, then
+    // advances a frame with the local input. Returns false when too far
+    // ahead of the remote peer to advance.
+    bool update(Uint8 localInput);
+
+    // Gets the current state
+    const VersusState& getState() const { return mState; }
+
+    // Gets the first frame whose remote input is not yet known
+    int getConfirmedFrame() const { return std::min(mRemoteHead, mState.frame); }
+
+    // Copies the snapshot taken at the start of a frame still in the history
+    bool getSnapshot(int frame, VersusState& out) const;
+
+    const RollbackStats& getStats() const { return mStats; }
+
+private:
+    // Reads every waiting packet, noting the earliest mispredicted frame
+    void receive();
+
+    // Sends the inputs the remote peer has not acknowledged
+    void send();
+
+    // Snapshots the state, then steps it with the frame's inputs
+    void simulate(int frame);
+
+    const AABBTree& mWalls;
+    int mLocal;
+    int mRemote;
+
+    UDPsocket mSocket;
+    UDPpacket* mPacket;
+    IPaddress mRemoteAddress;
+    int mLoss;
+    std::mt19937 mLossRng;
+
+    VersusState mState;
+    std::vector<VersusState> mSnapshots;  // Indexed by frame % ROLLBACK_HISTORY
+    Uint8 mInputs[ROLLBACK_HISTORY][2];
+    int mRemoteFrame[ROLLBACK_HISTORY];   // Frame whose remote input is confirmed in each slot
+
+    int mRemoteHead;    // Every remote input before this frame is known
+    int mRemoteAck;     // Every local input before this frame reached the peer
+    int mLastRemote;    // Latest frame heard from the peer
+    Uint8 mPrediction;  // Its input, assumed to hold for frames not yet heard
+    int mRollbackFrom;
+
+    RollbackStats mStats;
+};
+
+void initVersus(VersusState& state);
+void stepVersus(VersusState& state, const Uint8 inputs[2], const AABBTree& walls);
+Uint32 hashVersus(const VersusState& state);
+void planEnemies(void* data, int begin, int end);
+void updateBullets(std::vector<Bullet>& bullets, const AABBTree& walls, float dt);
+std::vector<EnemyTank> spawnEnemies(int count, const AABBTree& walls, unsigned seed);
+
+// The single-player game: the player's tank and the enemy tanks with their
+// bullets, among the level's walls. It only changes in fixed ticks, and
+// rendering blends the last two.
+class World {
+public:
+    World(int threads, int enemyCount);
+
+    // Takes key presses for the player's tank
+    void handleEvent(SDL_Event& e);
+
+    // Drives the player's tank from versus input bits, for headless runs
+    void applyInput(Uint8 input);
+
+    // Advances the game by dt seconds
+    void tick(float dt);
+
+    // Plays the sounds of the last tick; the tick only records them, so
+    // headless runs need no mixer
+    void playSounds();
+
+    // Shows the game, alpha of the way from the previous tick to the last
+    void render(float alpha);
+
+    // Gets the number of enemy tanks left
+    int getEnemyCount() const { return (int)mEnemies.size(); }
+
+private:
+    Tank mPlayer;
+    AABBTree mWalls;
+    JobSystem mJobs;
+    std::vector<EnemyTank> mEnemies;
+    std::vector<EnemyOrder> mOrders;
+    std::vector<SDL_Point> mTargets;
+    EnemyPlanJob mPlanJob;
+    std::vector<Bullet> mPlayerBullets;
+    std::vector<Bullet> mEnemyBullets;
+    OBBSet mEnemyHulls;
+    std::vector<int> mHits;
+    int mShotSounds;
+    int mExplosionSounds;
+    std::vector<int> mVisibleWalls;
+    std::vector<SDL_Rect> mWallRects;
+};
+
+// Times simulation ticks: how many ran and what they cost
+class TickProfiler {
+public:
+    TickProfiler() { reset(); }
+
+    // Brackets one tick
+    void begin() { mStart = SDL_GetPerformanceCounter(); }
+    void end();
+
+    // Starts counting afresh
+    void reset();
+
+    int getTicks() const { return mTicks; }
+    double getAverageMs() const { return mTicks > 0 ? mTotalMs / mTicks : 0.0; }
+    double getMaxMs() const { return mMaxMs; }
+
+private:
+    Uint64 mStart;
+    int mTicks;
+    double mTotalMs;
+    double mMaxMs;
+};
+
 // Globally used textures
 LTexture gTankTexture;
 LTexture gEnemyTankTexture;
@@ -175,6 +655,9 @@ LTexture::LTexture() {
     mTexture = nullptr;
     mWidth = 0;
     mHeight = 0;
+    mFrames = 0;
+    mFrameSize = 0;
+    mColumns = 0;
 }
 
 LTexture::~LTexture() {
@@ -183,6 +666,14 @@ LTexture::~LTexture() {
 }
 
 bool LTexture::loadFromFile(std::string path) {
+    // Use the sprite cache if it is current
+    std::string cachePath = path + TEXTURE_CACHE_SUFFIX;
+    Uint32 sourceHash = hashFile(path);
+    std::vector<Uint8> cache;
+    if (readCache(cachePath, sourceHash, cache)) {
+        return loadFromCache(cache, cachePath);
+    }
+
     // Get rid of preexisting texture
     free();
 
@@ -197,6 +688,13 @@ bool LTexture::loadFromFile(std::string path) {
         // Color key image
         SDL_SetColorKey(loadedSurface, SDL_TRUE, SDL_MapRGB(loadedSurface->format, 0, 0xFF, 0xFF));
 
+        // Cache it for next time
+        if (buildCache(loadedSurface, loadedSurface->w, loadedSurface->h, sourceHash, cache)) {
+            SDL_FreeSurface(loadedSurface);
+            writeCache(cachePath, cache);
+            return loadFromCache(cache, cachePath);
+        }
+
         // Create texture from surface pixels
         newTexture = SDL_CreateTextureFromSurface(gRenderer, loadedSurface);
         if (newTexture == nullptr) {
@@ -216,6 +714,210 @@ bool LTexture::loadFromFile(std::string path) {
     return mTexture != nullptr;
 }
 
+bool LTexture::loadRotationSheet(std::string path, int frames) {
+    // Use the cached sheet if it is current, skipping the rotation
+    std::string cachePath = path + ".rot" + std::to_string(frames) + TEXTURE_CACHE_SUFFIX;
+    Uint32 sourceHash = hashFile(path);
+    std::vector<Uint8> cache;
+    if (readCache(cachePath, sourceHash, cache) && loadFromCache(cache, cachePath)) {
+        int sheetWidth = 0;
+        SDL_QueryTexture(mTexture, nullptr, nullptr, &sheetWidth, nullptr);
+        mFrames = frames;
+        mColumns = (int)std::ceil(std::sqrt((double)frames));
+        mFrameSize = sheetWidth / mColumns;
+        return true;
+    }
+
+    // Get rid of preexisting texture
+    free();
+
+    // Load image at specified path as 32-bit ARGB
+    SDL_Surface* loadedSurface = IMG_Load(path.c_str());
+    if (loadedSurface == nullptr) {
+        std::cerr << "Unable to load image " << path << "! SDL_image Error: " << IMG_GetError() << std::endl;
+        return false;
+    }
+    SDL_Surface* source = SDL_ConvertSurfaceFormat(loadedSurface, SDL_PIXELFORMAT_ARGB8888, 0);
+    SDL_FreeSurface(loadedSurface);
+    if (source == nullptr) {
+        std::cerr << "Unable to convert image " << path << "! SDL Error: " << SDL_GetError() << std::endl;
+        return false;
+    }
+
+    // Every frame is a square cell that fits the image at any angle
+    int frameSize = (int)std::ceil(std::sqrt((double)(source->w * source->w + source->h * source->h)));
+    int columns = (int)std::ceil(std::sqrt((double)frames));
+    int rows = (frames + columns - 1) / columns;
+    SDL_Surface* sheet = SDL_CreateRGBSurfaceWithFormat(0, frameSize * columns, frameSize * rows, 32, SDL_PIXELFORMAT_ARGB8888);
+    if (sheet == nullptr) {
+        std::cerr << "Unable to create rotation sheet for " << path << "! SDL Error: " << SDL_GetError() << std::endl;
+        SDL_FreeSurface(source);
+        return false;
+    }
+    SDL_FillRect(sheet, nullptr, 0);
+
+    // Rotate by inverse mapping: each frame pixel samples the nearest source
+    // pixel. Coordinates are doubled so pixel centres stay integral.
+    SDL_LockSurface(source);
+    SDL_LockSurface(sheet);
+    for (int frame = 0; frame < frames; ++frame) {
+        int degrees = frame * 360 / frames;
+        int c = fixedCos(degrees);
+        int s = fixedSin(degrees);
+        int frameX = (frame % columns) * frameSize;
+        int frameY = (frame / columns) * frameSize;
+        for (int y = 0; y < frameSize; ++y) {
+            Uint32* out = (Uint32*)((Uint8*)sheet->pixels + (frameY + y) * sheet->pitch) + frameX;
+            int dy = 2 * y + 1 - frameSize;
+            for (int x = 0; x < frameSize; ++x) {
+                int dx = 2 * x + 1 - frameSize;
+                int sx = (c * dx + s * dy + (source->w << TRIG_SHIFT)) >> (TRIG_SHIFT + 1);
+                int sy = (c * dy - s * dx + (source->h << TRIG_SHIFT)) >> (TRIG_SHIFT + 1);
+                if (sx < 0 || sy < 0 || sx >= source->w || sy >= source->h) {
+                    continue;
+                }
+                Uint32 pixel = *((Uint32*)((Uint8*)source->pixels + sy * source->pitch) + sx);
+
+                // Keep the colour key (cyan) transparent
+                out[x] = (pixel & 0x00FFFFFF) == 0x0000FFFF ? 0 : pixel;
+            }
+        }
+    }
+    SDL_UnlockSurface(sheet);
+    SDL_UnlockSurface(source);
+
+    // Create texture from the sheet, through the cache when it can be built
+    if (buildCache(sheet, source->w, source->h, sourceHash, cache)) {
+        writeCache(cachePath, cache);
+        loadFromCache(cache, cachePath);
+    } else {
+        mTexture = SDL_CreateTextureFromSurface(gRenderer, sheet);
+    }
+    if (mTexture == nullptr) {
+        std::cerr << "Unable to create texture from " << path << "! SDL Error: " << SDL_GetError() << std::endl;
+    } else {
+        if (cache.empty()) {
+            SDL_SetTextureBlendMode(mTexture, SDL_BLENDMODE_BLEND);
+        }
+        mWidth = source->w;
+        mHeight = source->h;
+        mFrames = frames;
+        mFrameSize = frameSize;
+        mColumns = columns;
+    }
+    SDL_FreeSurface(sheet);
+    SDL_FreeSurface(source);
+    return mTexture != nullptr;
+}
+
+bool LTexture::readCache(std::string path, Uint32 sourceHash, std::vector<Uint8>& cache) {
+    SDL_RWops* file = SDL_RWFromFile(path.c_str(), "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    Sint64 size = SDL_RWsize(file);
+    bool read = size >= (Sint64)sizeof(TextureCacheHeader);
+    if (read) {
+        cache.resize((size_t)size);
+        read = SDL_RWread(file, cache.data(), cache.size(), 1) == 1;
+    }
+    SDL_RWclose(file);
+    if (!read) {
+        cache.clear();
+        return false;
+    }
+
+    // Check it matches this renderer and the source image, and is intact
+    TextureCacheHeader header;
+    memcpy(&header, cache.data(), sizeof(header));
+    size_t pixelSize = (size_t)header.width * header.height * 4;
+    bool valid = header.magic == TEXTURE_CACHE_MAGIC && header.format == gTextureFormat && header.sourceHash == sourceHash &&
+                 header.width > 0 && header.height > 0 && cache.size() == sizeof(header) + pixelSize &&
+                 checksumPixels(cache.data() + sizeof(header), pixelSize) == header.checksum;
+    if (!valid) {
+        cache.clear();
+    }
+    return valid;
+}
+
+bool LTexture::buildCache(SDL_Surface* surface, int imageWidth, int imageHeight, Uint32 sourceHash, std::vector<Uint8>& cache) {
+    // Convert to the renderer's format; only 32-bit formats are cached
+    SDL_Surface* converted = SDL_ConvertSurfaceFormat(surface, gTextureFormat, 0);
+    if (converted == nullptr) {
+        return false;
+    }
+    if (converted->format->BytesPerPixel != 4) {
+        SDL_FreeSurface(converted);
+        return false;
+    }
+    TextureCacheHeader header = { TEXTURE_CACHE_MAGIC, gTextureFormat, converted->w, converted->h, imageWidth, imageHeight, sourceHash, 0 };
+    size_t rowSize = (size_t)converted->w * 4;
+    cache.resize(sizeof(header) + rowSize * converted->h);
+    Uint8* pixels = cache.data() + sizeof(header);
+
+    // Premultiply by alpha, with the color key (cyan) fully transparent
+    SDL_LockSurface(converted);
+    for (int y = 0; y < converted->h; ++y) {
+        const Uint32* in = (const Uint32*)((const Uint8*)converted->pixels + y * converted->pitch);
+        Uint32* out = (Uint32*)(pixels + y * rowSize);
+        for (int x = 0; x < converted->w; ++x) {
+            Uint8 r, g, b, a;
+            SDL_GetRGBA(in[x], converted->format, &r, &g, &b, &a);
+            if (r == 0 && g == 0xFF && b == 0xFF) {
+                a = 0;
+            }
+            out[x] = SDL_MapRGBA(converted->format, r * a / 255, g * a / 255, b * a / 255, a);
+        }
+    }
+    SDL_UnlockSurface(converted);
+    SDL_FreeSurface(converted);
+
+    header.checksum = checksumPixels(pixels, rowSize * header.height);
+    memcpy(cache.data(), &header, sizeof(header));
+    return true;
+}
+
+bool LTexture::writeCache(std::string path, const std::vector<Uint8>& cache) {
+    SDL_RWops* file = SDL_RWFromFile(path.c_str(), "wb");
+    bool written = file != nullptr && SDL_RWwrite(file, cache.data(), cache.size(), 1) == 1;
+    if (file != nullptr) {
+        SDL_RWclose(file);
+    }
+    if (!written) {
+        std::cerr << "Unable to write sprite cache " << path << "! SDL Error: " << SDL_GetError() << std::endl;
+    }
+    return written;
+}
+
+bool LTexture::loadFromCache(const std::vector<Uint8>& cache, std::string path) {
+    // Get rid of preexisting texture
+    free();
+
+    // Upload the pixels as they are
+    TextureCacheHeader header;
+    memcpy(&header, cache.data(), sizeof(header));
+    mTexture = SDL_CreateTexture(gRenderer, header.format, SDL_TEXTUREACCESS_STATIC, header.width, header.height);
+    if (mTexture == nullptr || SDL_UpdateTexture(mTexture, nullptr, cache.data() + sizeof(header), header.width * 4) < 0) {
+        std::cerr << "Unable to create texture from " << path << "! SDL Error: " << SDL_GetError() << std::endl;
+        free();
+        return false;
+    }
+
+    // Sprites are all-or-nothing alpha, so plain blending draws them the
+    // same where the renderer lacks the premultiplied mode
+    if (SDL_SetTextureBlendMode(mTexture, gPremultipliedBlend) < 0) {
+        SDL_SetTextureBlendMode(mTexture, SDL_BLENDMODE_BLEND);
+    }
+    mWidth = header.imageWidth;
+    mHeight = header.imageHeight;
+    return true;
+}
+
+void LTexture::setColor(Uint8 red, Uint8 green, Uint8 blue) {
+    // Modulate texture
+    SDL_SetTextureColorMod(mTexture, red, green, blue);
+}
+
 void LTexture::free() {
     // Free texture if it exists
     if (mTexture != nullptr) {
@@ -223,6 +925,9 @@ void LTexture::free() {
         mTexture = nullptr;
         mWidth = 0;
         mHeight = 0;
+        mFrames = 0;
+        mFrameSize = 0;
+        mColumns = 0;
     }
 }
 
@@ -240,6 +945,17 @@ void LTexture::render(int x, int y, SDL_Rect* clip, double angle, SDL_Point* cen
     SDL_RenderCopyEx(gRenderer, mTexture, clip, &renderQuad, angle, center, flip);
 }
 
+void LTexture::renderRotated(int x, int y, int degrees) {
+    // Pick the nearest frame
+    degrees = ((degrees % 360) + 360) % 360;
+    int frame = ((degrees * mFrames + 180) / 360) % mFrames;
+
+    // Copy it straight, centred on the unrotated image
+    SDL_Rect clip = { (frame % mColumns) * mFrameSize, (frame / mColumns) * mFrameSize, mFrameSize, mFrameSize };
+    SDL_Rect renderQuad = { x + mWidth / 2 - mFrameSize / 2, y + mHeight / 2 - mFrameSize / 2, mFrameSize, mFrameSize };
+    SDL_RenderCopy(gRenderer, mTexture, &clip, &renderQuad);
+}
+
 int LTexture::getWidth() {
     return mWidth;
 }
@@ -248,217 +964,1546 @@ int LTexture::getHeight() {
     return mHeight;
 }
 
-Tank::Tank() {
+Tank::Tank() : Tank(SCREEN_WIDTH / 2 - TANK_WIDTH / 2, SCREEN_HEIGHT - TANK_HEIGHT - 10, 0) {
+}
+
+Tank::Tank(int x, int y, int heading) {
     // Initialize the offsets
-    mPosX = SCREEN_WIDTH / 2 - TANK_WIDTH / 2;
-    mPosY = SCREEN_HEIGHT - TANK_HEIGHT - 10;
+    mPosX = (float)x;
+    mPosY = (float)y;
+    mPrevX = mPosX;
+    mPrevY = mPosY;
 
-    // Set collision box dimension
+    // Set collision box
+    mCollider.x = mPosX;
+    mCollider.y = mPosY;
     mCollider.w = TANK_WIDTH;
     mCollider.h = TANK_HEIGHT;
 
     // Initialize the velocity
     mVelX = 0;
     mVelY = 0;
+    mThrottle = 0;
 
-    // Initialize angle
-    mAngle = 0.0;
+    // Initialize heading
+    mHeading = heading;
 }
 
 void Tank::handleEvent(SDL_Event& e) {
     // If a key was pressed
     if (e.type == SDL_KEYDOWN && e.key.repeat == 0) {
-        // Adjust the velocity
+        // Adjust the throttle or turn
         switch (e.key.keysym.sym) {
         case SDLK_UP:
-            mVelY -= TANK_SPEED;
+            ++mThrottle;
             break;
         case SDLK_DOWN:
-            mVelY += TANK_SPEED;
+            --mThrottle;
             break;
         case SDLK_LEFT:
-            mAngle -= 5.0;
+            mHeading = (mHeading + 360 - ROTATION_STEP_DEGREES) % 360;
             break;
         case SDLK_RIGHT:
-            mAngle += 5.0;
+            mHeading = (mHeading + ROTATION_STEP_DEGREES) % 360;
             break;
         }
     }
     // If a key was released
     else if (e.type == SDL_KEYUP && e.key.repeat == 0) {
-        // Adjust the velocity
+        // Adjust the throttle
         switch (e.key.keysym.sym) {
         case SDLK_UP:
-            mVelY += TANK_SPEED;
+            --mThrottle;
             break;
         case SDLK_DOWN:
-            mVelY -= TANK_SPEED;
+            ++mThrottle;
             break;
         }
     }
+
+    updateVelocity();
 }
 
-void Tank::move(std::vector<SDL_Rect>& colliders) {
-    // Move the tank up or down
-    mPosY += mVelY;
-    mCollider.y = mPosY;
+void Tank::applyInput(Uint8 input) {
+    // Held keys, so turning is one step per tick
+    mThrottle = 0;
+    if (input & INPUT_UP) {
+        ++mThrottle;
+    }
+    if (input & INPUT_DOWN) {
+        --mThrottle;
+    }
+    if (input & INPUT_LEFT) {
+        mHeading = (mHeading + 360 - ROTATION_STEP_DEGREES) % 360;
+    }
+    if (input & INPUT_RIGHT) {
+        mHeading = (mHeading + ROTATION_STEP_DEGREES) % 360;
+    }
+
+    updateVelocity();
+}
+
+void Tank::updateVelocity() {
+    // Drive along the heading, so turning steers the tank
+    mVelX = mThrottle * TANK_SPEED * fixedCos(mHeading) / TRIG_ONE;
+    mVelY = mThrottle * TANK_SPEED * fixedSin(mHeading) / TRIG_ONE;
+}
+
+void Tank::move(const AABBTree& walls, float dt) {
+    mPrevX = mPosX;
+    mPrevY = mPosY;
+
+    // Move the tank up or down, stopping flush against any wall in the way.
+    // The collider is the position rounded down, so stopping flush leaves
+    // it touching the wall rather than inside it.
+    float stepY = mVelY * dt;
+    stepY *= walls.sweep(mCollider, 0, stepY);
+    mPosY += stepY;
+    mCollider.y = (int)std::floor(mPosY);
 
     // Keep the tank in bounds
     if ((mPosY < 0) || (mPosY + TANK_HEIGHT > SCREEN_HEIGHT)) {
         // Move back
-        mPosY -= mVelY;
-        mCollider.y = mPosY;
+        mPosY -= stepY;
+        mCollider.y = (int)std::floor(mPosY);
     }
 
-    // Move the tank left or right
-    mPosX += mVelX;
-    mCollider.x = mPosX;
+    // Move the tank left or right, resolved separately so it slides along walls
+    float stepX = mVelX * dt;
+    stepX *= walls.sweep(mCollider, stepX, 0);
+    mPosX += stepX;
+    mCollider.x = (int)std::floor(mPosX);
 
     // Keep the tank in bounds
     if ((mPosX < 0) || (mPosX + TANK_WIDTH > SCREEN_WIDTH)) {
         // Move back
-        mPosX -= mVelX;
-        mCollider.x = mPosX;
-    }
-
-    // Check for collisions with colliders
-    for (const auto& collider : colliders) {
-        if (checkCollision(mCollider, collider)) {
-            // Move back
-            mPosX -= mVelX;
-            mPosY -= mVelY;
-            mCollider.x = mPosX;
-            mCollider.y = mPosY;
-        }
+        mPosX -= stepX;
+        mCollider.x = (int)std::floor(mPosX);
     }
 }
 
-void Tank::render() {
-    // Show the tank
-    gTankTexture.render(mPosX, mPosY, nullptr, mAngle);
+void Tank::render(float alpha) const {
+    // Show the tank between its last two positions
+    gTankTexture.renderRotated((int)std::lround(mPrevX + (mPosX - mPrevX) * alpha), (int)std::lround(mPrevY + (mPosY - mPrevY) * alpha), mHeading);
 }
 
 SDL_Rect Tank::getCollider() const {
     return mCollider;
 }
 
-Bullet::Bullet(int x, int y, double angle) {
+OBB Tank::getHull() const {
+    return makeOBB(mPosX + TANK_WIDTH / 2.0f, mPosY + TANK_HEIGHT / 2.0f, mHeading, TANK_WIDTH, TANK_HEIGHT);
+}
+
+Bullet::Bullet(float x, float y, int heading) {
     // Initialize the offsets
     mPosX = x;
     mPosY = y;
+    mPrevX = x;
+    mPrevY = y;
 
-    // Set collision box dimension
+    // Set collision box
+    mCollider.x = (int)std::floor(mPosX);
+    mCollider.y = (int)std::floor(mPosY);
     mCollider.w = BULLET_WIDTH;
     mCollider.h = BULLET_HEIGHT;
 
     // Calculate velocity
-    mVelX = BULLET_SPEED * cos(angle * M_PI / 180.0);
-    mVelY = BULLET_SPEED * sin(angle * M_PI / 180.0);
+    mHeading = heading;
+    mVelX = BULLET_SPEED * fixedCos(heading) / TRIG_ONE;
+    mVelY = BULLET_SPEED * fixedSin(heading) / TRIG_ONE;
 
     // Set the active state
     active = true;
 }
 
-void Bullet::move() {
+Bullet::Bullet() : Bullet(0, 0, 0) {
+    active = false;
+}
+
+void Bullet::move(float dt) {
     // Move the bullet
-    mPosX += mVelX;
-    mPosY += mVelY;
+    mPrevX = mPosX;
+    mPrevY = mPosY;
+    mPosX += mVelX * dt;
+    mPosY += mVelY * dt;
 
     // Update the collider
-    mCollider.x = mPosX;
-    mCollider.y = mPosY;
+    mCollider.x = (int)std::floor(mPosX);
+    mCollider.y = (int)std::floor(mPosY);
 }
 
-void Bullet::render() {
-    // Show the bullet
-    gBulletTexture.render(mPosX, mPosY);
+void Bullet::render(float alpha) const {
+    // Show the bullet between its last two positions
+    gBulletTexture.render((int)std::lround(mPrevX + (mPosX - mPrevX) * alpha), (int)std::lround(mPrevY + (mPosY - mPrevY) * alpha));
 }
 
-SDL_Rect Bullet::getCollider() {
+SDL_Rect Bullet::getCollider() const {
     return mCollider;
 }
 
+OBB Bullet::getHull() const {
+    return makeOBB(mPosX + BULLET_WIDTH / 2.0f, mPosY + BULLET_HEIGHT / 2.0f, mHeading, BULLET_HEIGHT, BULLET_WIDTH);
+}
+
 EnemyTank::EnemyTank(int x, int y) {
-    mPosX = x;
-    mPosY = y;
-    mAngle = 0.0;
-    mVelX = ENEMY_TANK_SPEED;
-    mVelY = 0;
+    mPosX = (float)x;
+    mPosY = (float)y;
+    mPrevX = mPosX;
+    mPrevY = mPosY;
+    mHeading = 0;
+    mGoalX = 0;
+    mGoalY = 0;
+    mHasGoal = false;
+    mReload = 0.0f;
     alive = true;
 
-    // Set collision box dimension
+    // Set collision box
+    mCollider.x = x;
+    mCollider.y = y;
     mCollider.w = ENEMY_TANK_WIDTH;
     mCollider.h = ENEMY_TANK_HEIGHT;
 }
 
-void EnemyTank::move(const Tank& player) {
-    // Move the enemy tank towards the player tank
-    int playerX = player.getCollider().x + player.getCollider().w / 2;
-    int playerY = player.getCollider().y + player.getCollider().h / 2;
+EnemyOrder EnemyTank::plan(const std::vector<SDL_Point>& targets, const AABBTree& walls, float dt) const {
+    EnemyOrder order = { mPosX, mPosY, mHeading, mGoalX, mGoalY, mHasGoal, -1, false };
+    int centreX = mCollider.x + ENEMY_TANK_WIDTH / 2;
+    int centreY = mCollider.y + ENEMY_TANK_HEIGHT / 2;
+    float speed = ENEMY_TANK_SPEED * dt;
+
+    // Select the nearest target in range with a clear line of sight
+    int bestDistance = ENEMY_SIGHT_RANGE * ENEMY_SIGHT_RANGE;
+    for (size_t i = 0; i < targets.size(); ++i) {
+        int dx = targets[i].x - centreX;
+        int dy = targets[i].y - centreY;
+        int distance = dx * dx + dy * dy;
+        if (distance < bestDistance && walls.lineOfSight(centreX, centreY, targets[i].x, targets[i].y)) {
+            bestDistance = distance;
+            order.target = (int)i;
+        }
+    }
+
+    // Chase the target, or the place it was last seen
+    if (order.target >= 0) {
+        order.goalX = targets[order.target].x;
+        order.goalY = targets[order.target].y;
+        order.hasGoal = true;
+    }
+    if (order.hasGoal) {
+        int dx = order.goalX - centreX;
+        int dy = order.goalY - centreY;
+        if (order.target < 0 && std::abs(dx) + std::abs(dy) <= speed) {
+            // Reached the last sighting without finding anyone
+            order.hasGoal = false;
+        } else {
+            order.heading = lutAtan2(dy, dx);
+
+            // Move based on the angle, sliding along walls
+            SDL_Rect box = mCollider;
+            float stepY = speed * fixedSin(order.heading) / TRIG_ONE;
+            stepY *= walls.sweep(box, 0, stepY);
+            box.y = (int)std::floor(mPosY + stepY);
+            float stepX = speed * fixedCos(order.heading) / TRIG_ONE;
+            stepX *= walls.sweep(box, stepX, 0);
+            order.posX = std::max(0.0f, std::min(mPosX + stepX, (float)(SCREEN_WIDTH - ENEMY_TANK_WIDTH)));
+            order.posY = std::max(0.0f, std::min(mPosY + stepY, (float)(SCREEN_HEIGHT - ENEMY_TANK_HEIGHT)));
+        }
+    }
 
-    // Calculate angle to player
-    double angle = atan2(playerY - mPosY, playerX - mPosX) * 180.0 / M_PI;
+    // Fire when the target is in sight and the gun has reloaded
+    order.fire = order.target >= 0 && mReload <= 0.0f;
+    return order;
+}
 
-    // Move based on the angle
-    mPosX += mVelX * cos(angle * M_PI / 180.0);
-    mPosY += mVelY * sin(angle * M_PI / 180.0);
+void EnemyTank::apply(const EnemyOrder& order, float dt) {
+    mPrevX = mPosX;
+    mPrevY = mPosY;
+    mPosX = order.posX;
+    mPosY = order.posY;
+    mHeading = order.heading;
+    mGoalX = order.goalX;
+    mGoalY = order.goalY;
+    mHasGoal = order.hasGoal;
+    mReload = order.fire ? ENEMY_RELOAD_TIME : std::max(0.0f, mReload - dt);
 
     // Update collider
-    mCollider.x = mPosX;
-    mCollider.y = mPosY;
+    mCollider.x = (int)std::floor(mPosX);
+    mCollider.y = (int)std::floor(mPosY);
 }
 
-void EnemyTank::render() {
-    // Show the enemy tank
-    gEnemyTankTexture.render(mPosX, mPosY);
+void EnemyTank::render(float alpha) const {
+    // Show the enemy tank between its last two positions, facing the way it moves
+    gEnemyTankTexture.renderRotated((int)std::lround(mPrevX + (mPosX - mPrevX) * alpha), (int)std::lround(mPrevY + (mPosY - mPrevY) * alpha), mHeading);
 }
 
-SDL_Rect EnemyTank::getCollider() {
+SDL_Rect EnemyTank::getCollider() const {
     return mCollider;
 }
 
-// Check collision between two rectangles
-bool checkCollision(SDL_Rect a, SDL_Rect b) {
-    // Calculate the sides of each rectangle
-    int leftA = a.x;
-    int rightA = a.x + a.w;
-    int topA = a.y;
-    int bottomA = a.y + a.h;
-
-    int leftB = b.x;
-    int rightB = b.x + b.w;
-    int topB = b.y;
-    int bottomB = b.y + b.h;
-
-    // Check if there is a collision
-    return !(bottomA <= topB || topA >= bottomB || rightA <= leftB || leftA >= rightB);
+OBB EnemyTank::getHull() const {
+    return makeOBB(mPosX + ENEMY_TANK_WIDTH / 2.0f, mPosY + ENEMY_TANK_HEIGHT / 2.0f, mHeading, ENEMY_TANK_WIDTH, ENEMY_TANK_HEIGHT);
 }
 
-bool init() {
-    // Initialize SDL
-    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) < 0) {
-        std::cerr << "SDL could not initialize! SDL_Error: " << SDL_GetError() << std::endl;
-        return false;
+// Plans enemies [begin, end) into their orders
+void planEnemies(void* data, int begin, int end) {
+    EnemyPlanJob* job = static_cast<EnemyPlanJob*>(data);
+    for (int i = begin; i < end; ++i) {
+        (*job->orders)[i] = (*job->enemies)[i].plan(*job->targets, *job->walls, job->dt);
     }
+}
 
-    // Create window
-    gWindow = SDL_CreateWindow("Tank Game", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_SHOWN);
-    if (gWindow == nullptr) {
-        std::cerr << "Window could not be created! SDL_Error: " << SDL_GetError() << std::endl;
-        return false;
+// Places enemy tanks at random clear spots in the top half of the screen
+std::vector<EnemyTank> spawnEnemies(int count, const AABBTree& walls, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::vector<EnemyTank> enemies;
+    std::vector<int> blocking;
+    for (int attempt = 0; (int)enemies.size() < count && attempt < count * 100; ++attempt) {
+        SDL_Rect box = { (int)(rng() % (SCREEN_WIDTH - ENEMY_TANK_WIDTH)), (int)(rng() % (SCREEN_HEIGHT / 2)), ENEMY_TANK_WIDTH, ENEMY_TANK_HEIGHT };
+        blocking.clear();
+        walls.query(box, blocking);
+        if (blocking.empty()) {
+            enemies.push_back(EnemyTank(box.x, box.y));
+        }
     }
+    return enemies;
+}
 
-    // Create renderer for window
-    gRenderer = SDL_CreateRenderer(gWindow, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
-    if (gRenderer == nullptr) {
-        std::cerr << "Renderer could not be created! SDL_Error: " << SDL_GetError() << std::endl;
-        return false;
-    }
+World::World(int threads, int enemyCount) : mJobs(threads), mTargets(1), mShotSounds(0), mExplosionSounds(0) {
+    // Load the level's walls into the collision tree
+    mWalls.build(loadWalls("level1.txt"));
 
-    // Initialize SDL_image
-    if (!(IMG_Init(IMG_INIT_PNG) & IMG_INIT_PNG)) {
-        std::cerr << "SDL_image could not initialize! SDL_image Error: " << IMG_GetError() << std::endl;
-        return false;
+    // Create enemy tanks, planned in parallel each tick
+    mEnemies = spawnEnemies(enemyCount, mWalls, 1234);
+    mOrders.resize(mEnemies.size());
+    mPlanJob = { &mEnemies, &mTargets, &mWalls, &mOrders, 0.0f };
+}
+
+void World::handleEvent(SDL_Event& e) {
+    // Fire from the centre of the tank along its heading
+    if (e.type == SDL_KEYDOWN && e.key.repeat == 0 && e.key.keysym.sym == SDLK_SPACE) {
+        SDL_Rect box = mPlayer.getCollider();
+        mPlayerBullets.push_back(Bullet(box.x + box.w / 2 - Bullet::BULLET_WIDTH / 2, box.y + box.h / 2 - Bullet::BULLET_HEIGHT / 2, mPlayer.getHeading()));
+        Mix_PlayChannel(-1, gShootSound, 0);
+    }
+
+    // Handle player input
+    mPlayer.handleEvent(e);
+}
+
+void World::applyInput(Uint8 input) {
+    mPlayer.applyInput(input);
+}
+
+void World::tick(float dt) {
+    mShotSounds = 0;
+    mExplosionSounds = 0;
+
+    // Move player tank
+    mPlayer.move(mWalls, dt);
+
+    // Remove destroyed enemies
+    mEnemies.erase(std::remove_if(mEnemies.begin(), mEnemies.end(), [](const EnemyTank& t) { return !t.isAlive(); }), mEnemies.end());
+    mOrders.resize(mEnemies.size());
+
+    // Plan every enemy move from the same snapshot, then apply
+    // the orders in index order so runs reproduce
+    SDL_Rect playerBox = mPlayer.getCollider();
+    mTargets[0] = { playerBox.x + playerBox.w / 2, playerBox.y + playerBox.h / 2 };
+    mPlanJob.dt = dt;
+    mJobs.parallelFor((int)mEnemies.size(), ENEMY_CHUNK, planEnemies, &mPlanJob);
+    for (size_t i = 0; i < mEnemies.size(); ++i) {
+        mEnemies[i].apply(mOrders[i], dt);
+        if (mOrders[i].fire) {
+            SDL_Rect box = mEnemies[i].getCollider();
+            mEnemyBullets.push_back(Bullet(box.x + box.w / 2 - Bullet::BULLET_WIDTH / 2, box.y + box.h / 2 - Bullet::BULLET_HEIGHT / 2, mOrders[i].heading));
+            ++mShotSounds;
+        }
+    }
+
+    // Move bullets; they stop at walls and the screen edge
+    updateBullets(mPlayerBullets, mWalls, dt);
+    updateBullets(mEnemyBullets, mWalls, dt);
+
+    // Test each player bullet against every enemy hull at once; an enemy
+    // destroyed earlier in the tick no longer stops bullets
+    mEnemyHulls.clear();
+    for (const auto& enemy : mEnemies) {
+        mEnemyHulls.add(enemy.getHull());
+    }
+    for (auto& bullet : mPlayerBullets) {
+        mHits.clear();
+        mEnemyHulls.overlaps(bullet.getHull(), mHits);
+        mHits.erase(std::remove_if(mHits.begin(), mHits.end(), [this](int index) { return !mEnemies[index].isAlive(); }), mHits.end());
+        for (int index : mHits) {
+            mEnemies[index].setAlive(false);
+        }
+        if (!mHits.empty()) {
+            bullet.setActive(false);
+            ++mExplosionSounds;
+        }
+    }
+
+    // Enemy shells against the player's rotated hull
+    OBB playerHull = mPlayer.getHull();
+    for (auto& bullet : mEnemyBullets) {
+        if (checkCollision(playerHull, bullet.getHull())) {
+            bullet.setActive(false);
+            ++mExplosionSounds;
+        }
+    }
+}
+
+void World::playSounds() {
+    for (int i = 0; i < mShotSounds; ++i) {
+        Mix_PlayChannel(-1, gShootSound, 0);
+    }
+    for (int i = 0; i < mExplosionSounds; ++i) {
+        Mix_PlayChannel(-1, gExplosionSound, 0);
+    }
+    mShotSounds = 0;
+    mExplosionSounds = 0;
+}
+
+void World::render(float alpha) {
+    // Clear screen
+    SDL_RenderClear(gRenderer);
+
+    // Render background
+    gBackgroundTexture.render(0, 0);
+
+    // Render the walls on screen in one batch
+    SDL_Rect screen = { 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT };
+    mVisibleWalls.clear();
+    mWalls.query(screen, mVisibleWalls);
+    mWallRects.clear();
+    for (int index : mVisibleWalls) {
+        mWallRects.push_back(mWalls.getWall(index));
+    }
+    SDL_SetRenderDrawColor(gRenderer, 0x60, 0x60, 0x60, 0xFF);
+    SDL_RenderFillRects(gRenderer, mWallRects.data(), (int)mWallRects.size());
+
+    // Render the tanks and bullets
+    mPlayer.render(alpha);
+    for (const auto& enemy : mEnemies) {
+        enemy.render(alpha);
+    }
+    for (const auto& bullet : mPlayerBullets) {
+        if (bullet.isActive()) {
+            bullet.render(alpha);
+        }
+    }
+    for (const auto& bullet : mEnemyBullets) {
+        if (bullet.isActive()) {
+            bullet.render(alpha);
+        }
+    }
+
+    // Update screen
+    SDL_RenderPresent(gRenderer);
+}
+
+void TickProfiler::end() {
+    double ms = (SDL_GetPerformanceCounter() - mStart) * 1000.0 / SDL_GetPerformanceFrequency();
+    ++mTicks;
+    mTotalMs += ms;
+    mMaxMs = std::max(mMaxMs, ms);
+}
+
+void TickProfiler::reset() {
+    mStart = 0;
+    mTicks = 0;
+    mTotalMs = 0.0;
+    mMaxMs = 0.0;
+}
+
+// Moves bullets, retiring those that hit a wall or leave the screen
+void updateBullets(std::vector<Bullet>& bullets, const AABBTree& walls, float dt) {
+    static std::vector<int> hits;
+    SDL_Rect screen = { 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT };
+    for (auto& bullet : bullets) {
+        bullet.move(dt);
+        SDL_Rect box = bullet.getCollider();
+        hits.clear();
+        walls.query(box, hits);
+        if (!hits.empty() || !checkCollision(box, screen)) {
+            bullet.setActive(false);
+        }
+    }
+    bullets.erase(std::remove_if(bullets.begin(), bullets.end(), [](const Bullet& b) { return !b.isActive(); }), bullets.end());
+}
+
+JobSystem::JobSystem(int threads) {
+    threads = std::max(threads, 1);
+    mWake = SDL_CreateSemaphore(0);
+    SDL_AtomicSet(&mPending, 0);
+    SDL_AtomicSet(&mQuit, 0);
+    mQueues.resize(threads);
+    for (auto& queue : mQueues) {
+        queue.lock = SDL_CreateMutex();
+    }
+
+    // The worker records must not move once their threads have started
+    mWorkers.resize(threads);
+    for (int i = 1; i < threads; ++i) {
+        mWorkers[i] = { this, i };
+        SDL_Thread* thread = SDL_CreateThread(threadMain, "JobWorker", &mWorkers[i]);
+        if (thread == nullptr) {
+            std::cerr << "Unable to create job worker! SDL Error: " << SDL_GetError() << std::endl;
+        } else {
+            mThreads.push_back(thread);
+        }
+    }
+}
+
+JobSystem::~JobSystem() {
+    SDL_AtomicSet(&mQuit, 1);
+    for (size_t i = 0; i < mThreads.size(); ++i) {
+        SDL_SemPost(mWake);
+    }
+    for (SDL_Thread* thread : mThreads) {
+        SDL_WaitThread(thread, nullptr);
+    }
+    for (auto& queue : mQueues) {
+        SDL_DestroyMutex(queue.lock);
+    }
+    SDL_DestroySemaphore(mWake);
+}
+
+void JobSystem::parallelFor(int count, int chunk, JobFunc func, void* data) {
+    if (count <= 0) {
+        return;
+    }
+
+    // Count the jobs before any can finish, then deal them out round robin
+    int jobs = (count + chunk - 1) / chunk;
+    SDL_AtomicAdd(&mPending, jobs);
+    for (int i = 0; i < jobs; ++i) {
+        Queue& queue = mQueues[i % mQueues.size()];
+        SDL_LockMutex(queue.lock);
+        queue.jobs.push_back({ func, data, i * chunk, std::min((i + 1) * chunk, count) });
+        SDL_UnlockMutex(queue.lock);
+    }
+
+    // Wake the workers and help until everything is done
+    for (size_t i = 0; i < mThreads.size(); ++i) {
+        SDL_SemPost(mWake);
+    }
+    while (SDL_AtomicGet(&mPending) > 0) {
+        runJobs(0);
+    }
+}
+
+int JobSystem::threadMain(void* data) {
+    Worker* worker = static_cast<Worker*>(data);
+    JobSystem* system = worker->system;
+    for (;;) {
+        SDL_SemWait(system->mWake);
+        if (SDL_AtomicGet(&system->mQuit)) {
+            break;
+        }
+        system->runJobs(worker->index);
+    }
+    return 0;
+}
+
+bool JobSystem::findJob(int worker, Job& job) {
+    // Newest job of our own first, while its data is still in cache
+    Queue& own = mQueues[worker];
+    SDL_LockMutex(own.lock);
+    bool found = !own.jobs.empty();
+    if (found) {
+        job = own.jobs.back();
+        own.jobs.pop_back();
+    }
+    SDL_UnlockMutex(own.lock);
+
+    // Otherwise steal the oldest job of another worker
+    for (size_t i = 1; !found && i < mQueues.size(); ++i) {
+        Queue& victim = mQueues[(worker + i) % mQueues.size()];
+        SDL_LockMutex(victim.lock);
+        found = !victim.jobs.empty();
+        if (found) {
+            job = victim.jobs.front();
+            victim.jobs.pop_front();
+        }
+        SDL_UnlockMutex(victim.lock);
+    }
+    return found;
+}
+
+void JobSystem::runJobs(int worker) {
+    Job job;
+    while (findJob(worker, job)) {
+        job.func(job.data, job.begin, job.end);
+        SDL_AtomicAdd(&mPending, -1);
+    }
+}
+
+// Hashes a file's bytes and size, so any edit to an image invalidates its
+// cache even when the file stays the same size. 0 if it cannot be read.
+Uint32 hashFile(const std::string& path) {
+    SDL_RWops* file = SDL_RWFromFile(path.c_str(), "rb");
+    if (file == nullptr) {
+        return 0;
+    }
+    Sint64 size = SDL_RWsize(file);
+    std::vector<Uint8> bytes(size > 0 ? (size_t)size + 3 : 0, 0);  // Padded to whole words
+    bool read = size > 0 && SDL_RWread(file, bytes.data(), 1, (size_t)size) == (size_t)size;
+    SDL_RWclose(file);
+    if (!read) {
+        return 0;
+    }
+    return (checksumPixels(bytes.data(), bytes.size()) ^ (Uint32)size) * 16777619u;
+}
+
+// FNV-1a over 32-bit words, so checking a cache costs little next to reading it
+Uint32 checksumPixels(const Uint8* pixels, size_t size) {
+    Uint32 hash = 2166136261u;
+    for (size_t i = 0; i + 4 <= size; i += 4) {
+        Uint32 word;
+        memcpy(&word, pixels + i, 4);
+        hash = (hash ^ word) * 16777619u;
+    }
+    return hash;
+}
+
+// Check collision between two rectangles
+bool checkCollision(SDL_Rect a, SDL_Rect b) {
+    // Calculate the sides of each rectangle
+    int leftA = a.x;
+    int rightA = a.x + a.w;
+    int topA = a.y;
+    int bottomA = a.y + a.h;
+
+    int leftB = b.x;
+    int rightB = b.x + b.w;
+    int topB = b.y;
+    int bottomB = b.y + b.h;
+
+    // Check if there is a collision
+    return !(bottomA <= topB || topA >= bottomB || rightA <= leftB || leftA >= rightB);
+}
+
+// Builds an oriented box from its centre, heading and size
+OBB makeOBB(float cx, float cy, int heading, float length, float width) {
+    OBB box;
+    box.cx = cx;
+    box.cy = cy;
+    box.ux = fixedCos(heading) * (1.0f / TRIG_ONE);
+    box.uy = fixedSin(heading) * (1.0f / TRIG_ONE);
+    box.hx = length / 2;
+    box.hy = width / 2;
+    return box;
+}
+
+// Separating-axis test of box a against box b, given as fields so the
+// one-vs-many kernel can feed it straight from its arrays. With a's axes
+// u = (ux, uy) and v = (-uy, ux), c and s are the cosine and sine of the
+// angle between the boxes; each of the four axes is one comparison, and
+// the results are combined without branching.
+static inline int overlapSAT(const OBB& a, float cx, float cy, float ux, float uy, float hx, float hy) {
+    float dx = cx - a.cx;
+    float dy = cy - a.cy;
+    float c = std::fabs(a.ux * ux + a.uy * uy);
+    float s = std::fabs(a.ux * uy - a.uy * ux);
+    int onAU = std::fabs(dx * a.ux + dy * a.uy) < a.hx + hx * c + hy * s;
+    int onAV = std::fabs(dy * a.ux - dx * a.uy) < a.hy + hx * s + hy * c;
+    int onBU = std::fabs(dx * ux + dy * uy) < hx + a.hx * c + a.hy * s;
+    int onBV = std::fabs(dy * ux - dx * uy) < hy + a.hx * s + a.hy * c;
+    return onAU & onAV & onBU & onBV;
+}
+
+// Check collision between two oriented boxes
+bool checkCollision(const OBB& a, const OBB& b) {
+    return overlapSAT(a, b.cx, b.cy, b.ux, b.uy, b.hx, b.hy) != 0;
+}
+
+void OBBSet::clear() {
+    mCX.clear();
+    mCY.clear();
+    mUX.clear();
+    mUY.clear();
+    mHX.clear();
+    mHY.clear();
+    mEX.clear();
+    mEY.clear();
+}
+
+void OBBSet::add(const OBB& box) {
+    mCX.push_back(box.cx);
+    mCY.push_back(box.cy);
+    mUX.push_back(box.ux);
+    mUY.push_back(box.uy);
+    mHX.push_back(box.hx);
+    mHY.push_back(box.hy);
+    mEX.push_back(std::fabs(box.ux) * box.hx + std::fabs(box.uy) * box.hy);
+    mEY.push_back(std::fabs(box.uy) * box.hx + std::fabs(box.ux) * box.hy);
+}
+
+int OBBSet::overlapBounds(const OBB& box, int* out) const {
+    float ex = std::fabs(box.ux) * box.hx + std::fabs(box.uy) * box.hy;
+    float ey = std::fabs(box.uy) * box.hx + std::fabs(box.ux) * box.hy;
+    const float* cx = mCX.data();
+    const float* cy = mCY.data();
+    const float* bx = mEX.data();
+    const float* by = mEY.data();
+    int count = 0;
+    for (int i = 0; i < size(); ++i) {
+        // Always write, only advance on a hit
+        out[count] = i;
+        count += (std::fabs(cx[i] - box.cx) < bx[i] + ex) & (std::fabs(cy[i] - box.cy) < by[i] + ey);
+    }
+    return count;
+}
+
+int OBBSet::overlapBoxes(const OBB& box, const int* candidates, int count, int* out) const {
+    int hits = 0;
+    for (int k = 0; k < count; ++k) {
+        int i = candidates[k];
+        out[hits] = i;
+        hits += overlapSAT(box, mCX[i], mCY[i], mUX[i], mUY[i], mHX[i], mHY[i]);
+    }
+    return hits;
+}
+
+void OBBSet::overlaps(const OBB& box, std::vector<int>& out) const {
+    mCandidates.resize(size());
+    mHits.resize(size());
+    int candidates = overlapBounds(box, mCandidates.data());
+    int hits = overlapBoxes(box, mCandidates.data(), candidates, mHits.data());
+    out.insert(out.end(), mHits.begin(), mHits.begin() + hits);
+}
+
+void AABBTree::build(const std::vector<SDL_Rect>& walls) {
+    mWalls = walls;
+    mNodes.clear();
+    mNodes.reserve(2 * walls.size() / WALL_LEAF_SIZE + 1);
+    mOrder.resize(walls.size());
+    for (size_t i = 0; i < walls.size(); ++i) {
+        mOrder[i] = (int)i;
+    }
+    if (!walls.empty()) {
+        buildNode(0, (int)walls.size());
+    }
+}
+
+void AABBTree::buildNode(int first, int count) {
+    // Bound every wall in the range
+    Node node = { INT_MAX, INT_MAX, INT_MIN, INT_MIN, first, count };
+    for (int i = first; i < first + count; ++i) {
+        const SDL_Rect& wall = mWalls[mOrder[i]];
+        node.minX = std::min(node.minX, wall.x);
+        node.minY = std::min(node.minY, wall.y);
+        node.maxX = std::max(node.maxX, wall.x + wall.w);
+        node.maxY = std::max(node.maxY, wall.y + wall.h);
+    }
+    int index = (int)mNodes.size();
+    mNodes.push_back(node);
+    if (count <= WALL_LEAF_SIZE) {
+        return;
+    }
+
+    // Split at the median centre along the longer axis
+    bool splitX = node.maxX - node.minX >= node.maxY - node.minY;
+    int half = count / 2;
+    std::nth_element(mOrder.begin() + first, mOrder.begin() + first + half, mOrder.begin() + first + count, [this, splitX](int a, int b) {
+        const SDL_Rect& wa = mWalls[a];
+        const SDL_Rect& wb = mWalls[b];
+        return splitX ? 2 * wa.x + wa.w < 2 * wb.x + wb.w : 2 * wa.y + wa.h < 2 * wb.y + wb.h;
+    });
+
+    // The left child follows this node; the right child's index is patched in
+    buildNode(first, half);
+    mNodes[index].first = (int)mNodes.size();
+    mNodes[index].count = 0;
+    buildNode(first + half, count - half);
+}
+
+void AABBTree::query(const SDL_Rect& box, std::vector<int>& out) const {
+    if (mNodes.empty()) {
+        return;
+    }
+    int stack[64];
+    int depth = 0;
+    stack[depth++] = 0;
+    while (depth > 0) {
+        int index = stack[--depth];
+        const Node& node = mNodes[index];
+        if (box.x >= node.maxX || box.x + box.w <= node.minX || box.y >= node.maxY || box.y + box.h <= node.minY) {
+            continue;
+        }
+        if (node.count == 0) {
+            stack[depth++] = node.first;
+            stack[depth++] = index + 1;
+            continue;
+        }
+        for (int i = node.first; i < node.first + node.count; ++i) {
+            if (checkCollision(box, mWalls[mOrder[i]])) {
+                out.push_back(mOrder[i]);
+            }
+        }
+    }
+}
+
+float AABBTree::sweep(const SDL_Rect& box, float dx, float dy) const {
+    if (mNodes.empty()) {
+        return 1.0f;
+    }
+
+    // Only nodes touching the area swept by the box can stop it
+    float sweptMinX = box.x + std::min(dx, 0.0f);
+    float sweptMinY = box.y + std::min(dy, 0.0f);
+    float sweptMaxX = box.x + box.w + std::max(dx, 0.0f);
+    float sweptMaxY = box.y + box.h + std::max(dy, 0.0f);
+
+    float hit = 1.0f;
+    int stack[64];
+    int depth = 0;
+    stack[depth++] = 0;
+    while (depth > 0) {
+        int index = stack[--depth];
+        const Node& node = mNodes[index];
+        if (sweptMinX >= node.maxX || sweptMaxX <= node.minX || sweptMinY >= node.maxY || sweptMaxY <= node.minY) {
+            continue;
+        }
+        if (node.count == 0) {
+            stack[depth++] = node.first;
+            stack[depth++] = index + 1;
+            continue;
+        }
+        for (int i = node.first; i < node.first + node.count; ++i) {
+            const SDL_Rect& wall = mWalls[mOrder[i]];
+            if (checkCollision(box, wall)) {
+                continue;
+            }
+
+            // Slab test of the box's corner against the wall grown by the box
+            float enter = 0.0f;
+            float exit = 1.0f;
+            float lowX = wall.x - box.w - box.x;
+            float highX = wall.x + wall.w - box.x;
+            float lowY = wall.y - box.h - box.y;
+            float highY = wall.y + wall.h - box.y;
+            if (dx != 0.0f) {
+                float t0 = lowX / dx;
+                float t1 = highX / dx;
+                enter = std::max(enter, std::min(t0, t1));
+                exit = std::min(exit, std::max(t0, t1));
+            } else if (lowX >= 0.0f || highX <= 0.0f) {
+                continue;
+            }
+            if (dy != 0.0f) {
+                float t0 = lowY / dy;
+                float t1 = highY / dy;
+                enter = std::max(enter, std::min(t0, t1));
+                exit = std::min(exit, std::max(t0, t1));
+            } else if (lowY >= 0.0f || highY <= 0.0f) {
+                continue;
+            }
+            if (enter < exit && enter < hit) {
+                hit = enter;
+            }
+        }
+    }
+    return hit;
+}
+
+// Load the level's walls: one "x,y,w,h" rectangle per line, '#' starts a comment
+std::vector<SDL_Rect> loadWalls(const std::string& path) {
+    std::vector<SDL_Rect> walls;
+    std::ifstream levelFile(path);
+    if (!levelFile.is_open()) {
+        std::cerr << "Unable to open level file: " << path << std::endl;
+        return walls;
+    }
+    std::string line;
+    while (std::getline(levelFile, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        SDL_Rect wall;
+        char comma;
+        std::stringstream ss(line);
+        if (ss >> wall.x >> comma >> wall.y >> comma >> wall.w >> comma >> wall.h) {
+            walls.push_back(wall);
+        }
+    }
+    return walls;
+}
+
+// Time the wall tree against a linear scan. Walls come from the given level
+// file, or 100k random segments when none is given.
+void benchmarkWalls(const char* path) {
+    const int QUERIES = 100000;
+    const int LINEAR_QUERIES = 200;
+    std::mt19937 rng(1234);
+
+    std::vector<SDL_Rect> walls;
+    int arena = 0;
+    Uint64 start = SDL_GetPerformanceCounter();
+    if (path != nullptr) {
+        walls = loadWalls(path);
+        for (const auto& wall : walls) {
+            arena = std::max(arena, std::max(wall.x + wall.w, wall.y + wall.h));
+        }
+    } else {
+        // Short horizontal and vertical segments over a square arena
+        arena = 20000;
+        for (int i = 0; i < 100000; ++i) {
+            int length = 16 + rng() % 112;
+            bool horizontal = rng() % 2 == 0;
+            walls.push_back({ (int)(rng() % arena), (int)(rng() % arena), horizontal ? length : 8, horizontal ? 8 : length });
+        }
+    }
+    double loadMs = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+    if (walls.empty() || arena <= 0) {
+        std::cerr << "No walls to benchmark!" << std::endl;
+        return;
+    }
+
+    AABBTree tree;
+    start = SDL_GetPerformanceCounter();
+    tree.build(walls);
+    double buildMs = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+
+    // Tank-sized boxes at random places, moving up to a tank's move in a 60 Hz frame
+    const int MOVE = (int)(TANK_SPEED / 60);
+    std::vector<SDL_Rect> boxes(QUERIES);
+    std::vector<SDL_Point> moves(QUERIES);
+    for (int i = 0; i < QUERIES; ++i) {
+        boxes[i] = { (int)(rng() % arena), (int)(rng() % arena), TANK_WIDTH, TANK_HEIGHT };
+        moves[i] = { (int)(rng() % (2 * MOVE + 1)) - MOVE, (int)(rng() % (2 * MOVE + 1)) - MOVE };
+    }
+
+    std::vector<int> hits;
+    size_t found = 0;
+    start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < QUERIES; ++i) {
+        hits.clear();
+        tree.query(boxes[i], hits);
+        found += hits.size();
+    }
+    double queryMs = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+
+    float travelled = 0.0f;
+    start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < QUERIES; ++i) {
+        travelled += tree.sweep(boxes[i], (float)moves[i].x, (float)moves[i].y);
+    }
+    double sweepMs = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+
+    // The linear scan the tree replaces, checked against the tree's answers
+    size_t linearFound = 0;
+    size_t treeFound = 0;
+    start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < LINEAR_QUERIES; ++i) {
+        for (const auto& wall : walls) {
+            linearFound += checkCollision(boxes[i], wall) ? 1 : 0;
+        }
+    }
+    double linearMs = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+    for (int i = 0; i < LINEAR_QUERIES; ++i) {
+        hits.clear();
+        tree.query(boxes[i], hits);
+        treeFound += hits.size();
+    }
+
+    std::cout << walls.size() << " walls loaded in " << loadMs << " ms, tree built in " << buildMs << " ms" << std::endl;
+    std::cout << "Box query: " << queryMs * 1000.0 / QUERIES << " us (" << found << " hits)" << std::endl;
+    std::cout << "Swept box: " << sweepMs * 1000.0 / QUERIES << " us (mean travel " << travelled / QUERIES << ")" << std::endl;
+    std::cout << "Linear scan: " << linearMs * 1000.0 / LINEAR_QUERIES << " us per query"
+              << (linearFound == treeFound ? "" : " (MISMATCH with tree!)") << std::endl;
+}
+
+// Plan and apply the given number of enemy tanks for a fixed run with 1 to
+// N threads, reporting the speedup and a hash of the final state, which must
+// match across thread counts
+void benchmarkAI(int tanks) {
+    const int FRAMES = 300;
+    initTrigTables();
+    AABBTree walls;
+    walls.build(loadWalls("level1.txt"));
+    int maxThreads = std::max(SDL_GetCPUCount(), 1);
+
+    std::cout << tanks << " tanks, " << FRAMES << " frames, " << walls.size() << " walls" << std::endl;
+    double singleMs = 0.0;
+    for (int threads = 1; threads <= maxThreads; ++threads) {
+        JobSystem jobs(threads);
+        std::vector<EnemyTank> enemies = spawnEnemies(tanks, walls, 1234);
+        std::vector<EnemyOrder> orders(enemies.size());
+        std::vector<SDL_Point> targets(2);
+        EnemyPlanJob job = { &enemies, &targets, &walls, &orders, 1.0f / DEFAULT_SIM_HZ };
+        int shots = 0;
+
+        Uint64 start = SDL_GetPerformanceCounter();
+        for (int frame = 0; frame < FRAMES; ++frame) {
+            // Two targets circle the arena so sight lines keep changing
+            targets[0] = { SCREEN_WIDTH / 2 + ((200 * fixedCos(frame)) >> TRIG_SHIFT), SCREEN_HEIGHT / 2 + ((150 * fixedSin(frame)) >> TRIG_SHIFT) };
+            targets[1] = { SCREEN_WIDTH / 2 - ((250 * fixedCos(frame * 2)) >> TRIG_SHIFT), SCREEN_HEIGHT / 2 + ((100 * fixedSin(frame * 3)) >> TRIG_SHIFT) };
+            jobs.parallelFor((int)enemies.size(), ENEMY_CHUNK, planEnemies, &job);
+            for (size_t i = 0; i < enemies.size(); ++i) {
+                enemies[i].apply(orders[i], job.dt);
+                shots += orders[i].fire ? 1 : 0;
+            }
+        }
+        double ms = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+        if (threads == 1) {
+            singleMs = ms;
+        }
+
+        // FNV-1a over every tank's final state
+        Uint32 hash = 2166136261u;
+        for (const auto& enemy : enemies) {
+            int state[3] = { enemy.getCollider().x, enemy.getCollider().y, enemy.getHeading() };
+            for (int value : state) {
+                hash = (hash ^ (Uint32)value) * 16777619u;
+            }
+        }
+        std::cout << threads << " thread(s): " << ms / FRAMES << " ms per frame, speedup " << singleMs / ms
+                  << ", " << shots << " shots, state hash " << std::hex << hash << std::dec << std::endl;
+    }
+}
+
+// Fill the sin and atan tables
+void initTrigTables() {
+    for (int i = 0; i < 360; ++i) {
+        gSinTable[i] = (int)std::lround(std::sin(i * M_PI / 180.0) * TRIG_ONE);
+    }
+    for (int i = 0; i <= ATAN_TABLE_SIZE; ++i) {
+        gAtanTable[i] = (int)std::lround(std::atan((double)i / ATAN_TABLE_SIZE) * 180.0 / M_PI);
+    }
+}
+
+// Sine of an angle in whole degrees, Q14
+int fixedSin(int degrees) {
+    return gSinTable[((degrees % 360) + 360) % 360];
+}
+
+// Cosine of an angle in whole degrees, Q14
+int fixedCos(int degrees) {
+    return fixedSin(degrees + 90);
+}
+
+// Angle of (x, y) in whole degrees [0, 360), from the octant and the atan
+// table; no floating point
+int lutAtan2(int y, int x) {
+    if (x == 0 && y == 0) {
+        return 0;
+    }
+    int ax = std::abs(x);
+    int ay = std::abs(y);
+    int angle;
+    if (ay <= ax) {
+        angle = gAtanTable[(ay * ATAN_TABLE_SIZE + ax / 2) / ax];
+    } else {
+        angle = 90 - gAtanTable[(ax * ATAN_TABLE_SIZE + ay / 2) / ay];
+    }
+    if (x < 0) {
+        angle = 180 - angle;
+    }
+    if (y < 0) {
+        angle = 360 - angle;
+    }
+    return angle % 360;
+}
+
+// Compare rotated-sprite throughput: SDL_RenderCopyEx at arbitrary angles
+// against straight copies out of the pre-rotated sheet. Run with
+// SDL_RENDER_DRIVER=software to measure the software renderer.
+void benchmarkRotation() {
+    const int SPRITES = 2000;
+    const int FRAMES = 60;
+
+    // The unrotated image, for the RenderCopyEx pass
+    LTexture plainTexture;
+    if (!plainTexture.loadFromFile("tank.png")) {
+        std::cerr << "Failed to load benchmark texture!" << std::endl;
+        return;
+    }
+
+    SDL_RendererInfo info;
+    SDL_GetRendererInfo(gRenderer, &info);
+    std::cout << "Renderer: " << info.name << ", " << SPRITES << " sprites x " << FRAMES << " frames" << std::endl;
+
+    double passMs[2];
+    for (int pass = 0; pass < 2; ++pass) {
+        Uint64 start = SDL_GetPerformanceCounter();
+        for (int frame = 0; frame < FRAMES; ++frame) {
+            SDL_RenderClear(gRenderer);
+            for (int i = 0; i < SPRITES; ++i) {
+                int x = (i * 37) % (SCREEN_WIDTH - TANK_WIDTH);
+                int y = (i * 91) % (SCREEN_HEIGHT - TANK_HEIGHT);
+                int degrees = (i * 7 + frame * 3) % 360;
+                if (pass == 0) {
+                    plainTexture.render(x, y, nullptr, degrees);
+                } else {
+                    gTankTexture.renderRotated(x, y, degrees);
+                }
+            }
+
+            // Make the renderer execute the batch before the clock stops
+            SDL_RenderFlush(gRenderer);
+        }
+        passMs[pass] = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+    }
+
+    const char* names[2] = { "RenderCopyEx", "Rotation sheet" };
+    for (int pass = 0; pass < 2; ++pass) {
+        std::cout << names[pass] << ": " << passMs[pass] / FRAMES << " ms per frame, "
+                  << (int)(SPRITES * FRAMES / (passMs[pass] / 1000.0)) << " sprites/s" << std::endl;
+    }
+    std::cout << "Speedup: " << passMs[0] / passMs[1] << "x" << std::endl;
+}
+
+// Places the two tanks at opposite sides of the arena, facing each other
+void initVersus(VersusState& state) {
+    state = VersusState();
+    state.tanks[0] = Tank(40, SCREEN_HEIGHT / 2 - TANK_HEIGHT / 2, 0);
+    state.tanks[1] = Tank(SCREEN_WIDTH - 40 - TANK_WIDTH, SCREEN_HEIGHT / 2 - TANK_HEIGHT / 2, 180);
+    for (int i = 0; i < VERSUS_MAX_BULLETS; ++i) {
+        state.bullets[i] = Bullet();
+    }
+}
+
+// Advances the versus game one frame. It depends only on the state, the
+// inputs and the walls, so both peers and every re-simulation agree.
+void stepVersus(VersusState& state, const Uint8 inputs[2], const AABBTree& walls) {
+    static std::vector<int> hits;
+
+    // Drive the tanks and fire
+    for (int i = 0; i < 2; ++i) {
+        Tank& tank = state.tanks[i];
+        tank.applyInput(inputs[i]);
+        tank.move(walls, VERSUS_DT);
+        if (state.reload[i] > 0) {
+            --state.reload[i];
+        } else if ((inputs[i] & INPUT_FIRE) && state.bulletCount < VERSUS_MAX_BULLETS) {
+            SDL_Rect box = tank.getCollider();
+            state.bullets[state.bulletCount] = Bullet(box.x + box.w / 2 - Bullet::BULLET_WIDTH / 2, box.y + box.h / 2 - Bullet::BULLET_HEIGHT / 2, tank.getHeading());
+            state.bulletOwner[state.bulletCount] = i;
+            ++state.bulletCount;
+            state.reload[i] = VERSUS_RELOAD_FRAMES;
+        }
+    }
+
+    // Move the bullets; they stop at walls, the screen edge and the other tank
+    SDL_Rect screen = { 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT };
+    OBB hulls[2] = { state.tanks[0].getHull(), state.tanks[1].getHull() };
+    int kept = 0;
+    for (int i = 0; i < state.bulletCount; ++i) {
+        Bullet& bullet = state.bullets[i];
+        bullet.move(VERSUS_DT);
+        SDL_Rect box = bullet.getCollider();
+        hits.clear();
+        walls.query(box, hits);
+        int target = 1 - state.bulletOwner[i];
+        if (checkCollision(hulls[target], bullet.getHull())) {
+            ++state.score[state.bulletOwner[i]];
+        } else if (hits.empty() && checkCollision(box, screen)) {
+            // Still flying; keep the list packed
+            state.bullets[kept] = bullet;
+            state.bulletOwner[kept] = state.bulletOwner[i];
+            ++kept;
+        }
+    }
+    state.bulletCount = kept;
+
+    ++state.frame;
+}
+
+// FNV-1a hash of the versus state, field by field so padding is left out
+Uint32 hashVersus(const VersusState& state) {
+    std::vector<int> fields = { state.frame, state.bulletCount };
+    for (int i = 0; i < 2; ++i) {
+        SDL_Rect box = state.tanks[i].getCollider();
+        fields.insert(fields.end(), { box.x, box.y, state.tanks[i].getHeading(), state.reload[i], state.score[i] });
+    }
+    for (int i = 0; i < state.bulletCount; ++i) {
+        SDL_Rect box = state.bullets[i].getCollider();
+        fields.insert(fields.end(), { box.x, box.y, state.bulletOwner[i] });
+    }
+    Uint32 hash = 2166136261u;
+    for (int field : fields) {
+        hash = (hash ^ (Uint32)field) * 16777619u;
+    }
+    return hash;
+}
+
+RollbackSession::RollbackSession(int localPlayer, const AABBTree& walls)
+    : mWalls(walls), mLocal(localPlayer), mRemote(1 - localPlayer), mSocket(nullptr), mPacket(nullptr), mLoss(0), mLossRng(localPlayer + 1), mSnapshots(ROLLBACK_HISTORY) {
+    initVersus(mState);
+    memset(mInputs, 0, sizeof(mInputs));
+    for (int i = 0; i < ROLLBACK_HISTORY; ++i) {
+        mRemoteFrame[i] = -1;
+    }
+    mRemoteHead = 0;
+    mRemoteAck = 0;
+    mLastRemote = -1;
+    mPrediction = 0;
+    mRollbackFrom = INT_MAX;
+    memset(&mStats, 0, sizeof(mStats));
+}
+
+RollbackSession::~RollbackSession() {
+    SDLNet_FreePacket(mPacket);
+    if (mSocket != nullptr) {
+        SDLNet_UDP_Close(mSocket);
+    }
+}
+
+bool RollbackSession::connect(const char* host) {
+    mSocket = SDLNet_UDP_Open(VERSUS_PORT + mLocal);
+    if (mSocket == nullptr) {
+        std::cerr << "Unable to open UDP port " << VERSUS_PORT + mLocal << "! SDL_net Error: " << SDLNet_GetError() << std::endl;
+        return false;
+    }
+    if (SDLNet_ResolveHost(&mRemoteAddress, host, VERSUS_PORT + mRemote) < 0) {
+        std::cerr << "Unable to resolve " << host << "! SDL_net Error: " << SDLNet_GetError() << std::endl;
+        return false;
+    }
+    mPacket = SDLNet_AllocPacket(ROLLBACK_PACKET_SIZE);
+    return mPacket != nullptr;
+}
+
+bool RollbackSession::getSnapshot(int frame, VersusState& out) const {
+    if (frame < std::max(0, mState.frame - ROLLBACK_HISTORY + 1) || frame > mState.frame) {
+        return false;
+    }
+    out = frame == mState.frame ? mState : mSnapshots[frame % ROLLBACK_HISTORY];
+    return true;
+}
+
+void RollbackSession::receive() {
+    // Packet: acknowledged frame, first frame, input count, inputs
+    while (SDLNet_UDP_Recv(mSocket, mPacket) > 0) {
+        if (mPacket->len < 9 || mPacket->address.host != mRemoteAddress.host || mPacket->address.port != mRemoteAddress.port) {
+            continue;
+        }
+        int ack = (int)SDLNet_Read32(mPacket->data);
+        int first = (int)SDLNet_Read32(mPacket->data + 4);
+        int count = std::min((int)mPacket->data[8], mPacket->len - 9);
+
+        // Drop corrupt packets: the peer cannot send inputs from outside the
+        // history, or acknowledge inputs that have not been sent yet
+        if (first < 0 || first >= mState.frame + ROLLBACK_HISTORY) {
+            continue;
+        }
+        mRemoteAck = std::min(std::max(mRemoteAck, ack), mState.frame);
+
+        for (int i = 0; i < count; ++i) {
+            int frame = first + i;
+            int slot = frame % ROLLBACK_HISTORY;
+            Uint8 input = mPacket->data[9 + i];
+
+            // Skip inputs already known or too far either side of the history
+            if (frame < mRemoteHead || frame >= mState.frame + ROLLBACK_HISTORY - ROLLBACK_MAX_PREDICTION || mRemoteFrame[slot] == frame) {
+                continue;
+            }
+            if (frame < mState.frame && mInputs[slot][mRemote] != input) {
+                mRollbackFrom = std::min(mRollbackFrom, frame);
+            }
+            mInputs[slot][mRemote] = input;
+            mRemoteFrame[slot] = frame;
+            if (frame > mLastRemote) {
+                mLastRemote = frame;
+                mPrediction = input;
+            }
+        }
+        while (mRemoteFrame[mRemoteHead % ROLLBACK_HISTORY] == mRemoteHead) {
+            ++mRemoteHead;
+        }
+    }
+}
+
+void RollbackSession::send() {
+    if (mLoss > 0 && (int)(mLossRng() % 100) < mLoss) {
+        return;
+    }
+    int first = std::max(mRemoteAck, mState.frame - ROLLBACK_HISTORY + 1);
+    int count = std::min(mState.frame - first, ROLLBACK_PACKET_SIZE - 9);
+    SDL_assert(count >= 0);
+    SDLNet_Write32((Uint32)mRemoteHead, mPacket->data);
+    SDLNet_Write32((Uint32)first, mPacket->data + 4);
+    mPacket->data[8] = (Uint8)count;
+    for (int i = 0; i < count; ++i) {
+        mPacket->data[9 + i] = mInputs[(first + i) % ROLLBACK_HISTORY][mLocal];
+    }
+    mPacket->len = 9 + count;
+    mPacket->address = mRemoteAddress;
+    SDLNet_UDP_Send(mSocket, -1, mPacket);
+}
+
+void RollbackSession::simulate(int frame) {
+    int slot = frame % ROLLBACK_HISTORY;
+    if (mRemoteFrame[slot] != frame) {
+        mInputs[slot][mRemote] = mPrediction;
+    }
+    memcpy(&mSnapshots[slot], &mState, sizeof(mState));
+    stepVersus(mState, mInputs[slot], mWalls);
+}
+
+bool RollbackSession::update(Uint8 localInput) {
+    receive();
+
+    // Restore the first mispredicted frame and play forward to the present
+    if (mRollbackFrom < mState.frame) {
+        Uint64 start = SDL_GetPerformanceCounter();
+        int present = mState.frame;
+        memcpy(&mState, &mSnapshots[mRollbackFrom % ROLLBACK_HISTORY], sizeof(mState));
+        for (int frame = mRollbackFrom; frame < present; ++frame) {
+            simulate(frame);
+        }
+        ++mStats.rollbacks;
+        mStats.resimFrames += present - mRollbackFrom;
+        mStats.maxDepth = std::max(mStats.maxDepth, present - mRollbackFrom);
+        mStats.resimMs += (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+    }
+    mRollbackFrom = INT_MAX;
+
+    // Wait rather than predict further than the history can undo
+    bool advanced = mState.frame - mRemoteHead < ROLLBACK_MAX_PREDICTION;
+    if (advanced) {
+        mInputs[mState.frame % ROLLBACK_HISTORY][mLocal] = localInput;
+        simulate(mState.frame);
+    } else {
+        ++mStats.stalls;
+    }
+    send();
+    return advanced;
+}
+
+// Times the narrow phase per pair, oriented boxes against the axis-aligned
+// rectangles the game used before, over tank-sized boxes at random headings
+void benchmarkSAT() {
+    const int BOXES = 4096;
+    const int QUERIES = 1024;
+    initTrigTables();
+    std::mt19937 rng(1234);
+
+    OBBSet set;
+    std::vector<SDL_Rect> rects;
+    std::vector<OBB> queries;
+    for (int i = 0; i < BOXES + QUERIES; ++i) {
+        OBB box = makeOBB((float)(rng() % SCREEN_WIDTH), (float)(rng() % SCREEN_HEIGHT), (int)(rng() % 360), TANK_WIDTH, TANK_HEIGHT);
+        if (i < BOXES) {
+            set.add(box);
+            rects.push_back({ (int)box.cx - TANK_WIDTH / 2, (int)box.cy - TANK_HEIGHT / 2, TANK_WIDTH, TANK_HEIGHT });
+        } else {
+            queries.push_back(box);
+        }
+    }
+    std::vector<int> all(BOXES);
+    std::vector<int> out(BOXES);
+    for (int i = 0; i < BOXES; ++i) {
+        all[i] = i;
+    }
+    double pairs = (double)BOXES * QUERIES;
+    double ticksToMs = 1000.0 / SDL_GetPerformanceFrequency();
+
+    // Axis-aligned rectangles
+    long aabbHits = 0;
+    Uint64 start = SDL_GetPerformanceCounter();
+    for (const auto& query : queries) {
+        SDL_Rect rect = { (int)query.cx - TANK_WIDTH / 2, (int)query.cy - TANK_HEIGHT / 2, TANK_WIDTH, TANK_HEIGHT };
+        for (const auto& other : rects) {
+            aabbHits += checkCollision(rect, other) ? 1 : 0;
+        }
+    }
+    double aabbMs = (SDL_GetPerformanceCounter() - start) * ticksToMs;
+
+    // The bounds pre-pass alone
+    long boundsHits = 0;
+    start = SDL_GetPerformanceCounter();
+    for (const auto& query : queries) {
+        boundsHits += set.overlapBounds(query, out.data());
+    }
+    double boundsMs = (SDL_GetPerformanceCounter() - start) * ticksToMs;
+
+    // The oriented narrow phase on every pair
+    long obbHits = 0;
+    start = SDL_GetPerformanceCounter();
+    for (const auto& query : queries) {
+        obbHits += set.overlapBoxes(query, all.data(), BOXES, out.data());
+    }
+    double obbMs = (SDL_GetPerformanceCounter() - start) * ticksToMs;
+
+    // Both phases, as the game runs them
+    std::vector<int> hits;
+    start = SDL_GetPerformanceCounter();
+    for (const auto& query : queries) {
+        hits.clear();
+        set.overlaps(query, hits);
+    }
+    double fullMs = (SDL_GetPerformanceCounter() - start) * ticksToMs;
+
+    std::cout << BOXES << " boxes x " << QUERIES << " queries" << std::endl;
+    std::cout << "AABB:            " << aabbMs * 1e6 / pairs << " ns per pair, " << aabbHits << " hits" << std::endl;
+    std::cout << "Bounds pre-pass: " << boundsMs * 1e6 / pairs << " ns per pair, " << boundsHits << " candidates" << std::endl;
+    std::cout << "OBB SAT:         " << obbMs * 1e6 / pairs << " ns per pair, " << obbHits << " hits" << std::endl;
+    std::cout << "OBB / AABB cost: " << obbMs / aabbMs << "x" << std::endl;
+    std::cout << "Pre-pass + SAT:  " << fullMs * 1e3 / QUERIES << " us per query" << std::endl;
+}
+
+// Made-up input for a benchmark player: held for 8 frames at a time, and
+// firing now and then
+static Uint8 benchInput(int player, int frame) {
+    Uint32 hash = (Uint32)(frame / 8 * 2 + player) * 2654435761u;
+    return (Uint8)((hash >> 13) & (INPUT_UP | INPUT_DOWN | INPUT_LEFT | INPUT_RIGHT | INPUT_FIRE));
+}
+
+// Measures snapshot, restore and re-simulation cost, then plays two peers
+// against each other over loopback UDP with lost packets and checks they
+// end up in the same state as a run without the network
+void benchmarkRollback() {
+    const int SNAPSHOTS = 100000;
+    const int FRAMES = 1200;
+    const int LOSS = 10;
+    initTrigTables();
+    AABBTree walls;
+    walls.build(loadWalls("level1.txt"));
+    double ticksToMs = 1000.0 / SDL_GetPerformanceFrequency();
+
+    // Play a while so the state has bullets in flight
+    VersusState state;
+    initVersus(state);
+    for (int frame = 0; frame < 200; ++frame) {
+        Uint8 inputs[2] = { benchInput(0, frame), benchInput(1, frame) };
+        stepVersus(state, inputs, walls);
+    }
+
+    // Snapshot into and restore from a ring, as the session does
+    std::vector<VersusState> ring(ROLLBACK_HISTORY);
+    Uint64 start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < SNAPSHOTS; ++i) {
+        state.frame = i;
+        memcpy(&ring[i % ROLLBACK_HISTORY], &state, sizeof(state));
+    }
+    double snapshotMs = (SDL_GetPerformanceCounter() - start) * ticksToMs;
+    long long checksum = 0;
+    start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < SNAPSHOTS; ++i) {
+        memcpy(&state, &ring[(i * 7) % ROLLBACK_HISTORY], sizeof(state));
+        checksum += state.frame;
+    }
+    double restoreMs = (SDL_GetPerformanceCounter() - start) * ticksToMs;
+
+    // Restore once, then re-simulate as many frames as fit in one tick
+    Uint64 budget = SDL_GetPerformanceFrequency() * VERSUS_TICK_MS / 1000;
+    int resimFrames = 0;
+    start = SDL_GetPerformanceCounter();
+    memcpy(&state, &ring[0], sizeof(state));
+    while (SDL_GetPerformanceCounter() - start < budget) {
+        Uint8 inputs[2] = { benchInput(0, resimFrames), benchInput(1, resimFrames) };
+        stepVersus(state, inputs, walls);
+        ++resimFrames;
+    }
+
+    std::cout << "Snapshot (" << sizeof(VersusState) << " bytes): " << snapshotMs * 1e6 / SNAPSHOTS << " ns" << std::endl;
+    std::cout << "Restore: " << restoreMs * 1e6 / SNAPSHOTS << " ns (checksum " << checksum << ")" << std::endl;
+    std::cout << "Re-simulated frames per " << VERSUS_TICK_MS << " ms tick: " << resimFrames << " (" << VERSUS_TICK_MS * 1000.0 / resimFrames << " us each)" << std::endl;
+
+    // Two peers over loopback, stepped alternately
+    if (SDLNet_Init() < 0) {
+        std::cerr << "SDL_net could not initialize! SDL_net Error: " << SDLNet_GetError() << std::endl;
+        return;
+    }
+    {
+        RollbackSession peers[2] = { RollbackSession(0, walls), RollbackSession(1, walls) };
+        if (peers[0].connect("localhost") && peers[1].connect("localhost")) {
+            for (int i = 0; i < 2; ++i) {
+                peers[i].setLoss(LOSS);
+            }
+            while (peers[0].getState().frame < FRAMES || peers[1].getState().frame < FRAMES) {
+                for (int i = 0; i < 2; ++i) {
+                    if (peers[i].getState().frame < FRAMES) {
+                        peers[i].update(benchInput(i, peers[i].getState().frame));
+                    }
+                }
+            }
+
+            // Compare at the latest frame both peers know every input for
+            int confirmed = std::min(peers[0].getConfirmedFrame(), peers[1].getConfirmedFrame());
+            VersusState reference;
+            initVersus(reference);
+            while (reference.frame < confirmed) {
+                Uint8 inputs[2] = { benchInput(0, reference.frame), benchInput(1, reference.frame) };
+                stepVersus(reference, inputs, walls);
+            }
+            std::cout << "Loopback, " << LOSS << "% packet loss, " << FRAMES << " frames:" << std::endl;
+            for (int i = 0; i < 2; ++i) {
+                VersusState snapshot;
+                const RollbackStats& stats = peers[i].getStats();
+                bool match = peers[i].getSnapshot(confirmed, snapshot) && hashVersus(snapshot) == hashVersus(reference);
+                std::cout << "  player " << i << ": " << stats.rollbacks << " rollbacks, " << stats.resimFrames << " frames re-simulated (deepest " << stats.maxDepth << "), "
+                          << stats.stalls << " stalls, frame " << confirmed << " " << (match ? "matches" : "DIFFERS FROM") << " the reference" << std::endl;
+            }
+        }
+    }
+    SDLNet_Quit();
+}
+
+// Runs the single-player simulation without a window for the given game
+// time, as fast as it will go, with the player driven by made-up input
+void runHeadless(double seconds, int simHz, int threads, int enemyCount) {
+    initTrigTables();
+    World world(threads, enemyCount);
+    TickProfiler profiler;
+    int ticks = (int)(seconds * simHz);
+    float dt = 1.0f / simHz;
+
+    Uint64 start = SDL_GetPerformanceCounter();
+    for (int tick = 0; tick < ticks; ++tick) {
+        world.applyInput(benchInput(0, tick) & ~INPUT_FIRE);
+        profiler.begin();
+        world.tick(dt);
+        profiler.end();
+    }
+    double wallSeconds = (double)(SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+
+    std::cout << ticks << " ticks at " << simHz << " Hz (" << seconds << " s of game time) in " << wallSeconds << " s, "
+              << seconds / wallSeconds << "x real time" << std::endl;
+    std::cout << "Tick cost: " << profiler.getAverageMs() << " ms average, " << profiler.getMaxMs() << " ms worst; "
+              << world.getEnemyCount() << " enemies left" << std::endl;
+}
+
+bool init() {
+    // Initialize SDL
+    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) < 0) {
+        std::cerr << "SDL could not initialize! SDL_Error: " << SDL_GetError() << std::endl;
+        return false;
+    }
+
+    // Create window
+    gWindow = SDL_CreateWindow("Tank Game", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_SHOWN);
+    if (gWindow == nullptr) {
+        std::cerr << "Window could not be created! SDL_Error: " << SDL_GetError() << std::endl;
+        return false;
+    }
+
+    // Create renderer for window
+    gRenderer = SDL_CreateRenderer(gWindow, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
+    if (gRenderer == nullptr) {
+        std::cerr << "Renderer could not be created! SDL_Error: " << SDL_GetError() << std::endl;
+        return false;
+    }
+
+    // Cache sprites in the first 32-bit format with alpha the renderer takes
+    SDL_RendererInfo info;
+    if (SDL_GetRendererInfo(gRenderer, &info) == 0) {
+        for (Uint32 i = 0; i < info.num_texture_formats; ++i) {
+            if (SDL_ISPIXELFORMAT_ALPHA(info.texture_formats[i]) && SDL_BITSPERPIXEL(info.texture_formats[i]) == 32) {
+                gTextureFormat = info.texture_formats[i];
+                break;
+            }
+        }
+    }
+    gPremultipliedBlend = SDL_ComposeCustomBlendMode(SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD,
+                                                     SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD);
+
+    // Initialize SDL_image
+    if (!(IMG_Init(IMG_INIT_PNG) & IMG_INIT_PNG)) {
+        std::cerr << "SDL_image could not initialize! SDL_image Error: " << IMG_GetError() << std::endl;
+        return false;
     }
 
     // Initialize SDL_mixer
@@ -471,14 +2516,19 @@ bool init() {
 }
 
 bool loadMedia() {
-    // Load textures
-    if (!gTankTexture.loadFromFile("tank.png") ||
-        !gEnemyTankTexture.loadFromFile("enemy_tank.png") ||
+    // Build the trig tables the rotation sheets are made with
+    initTrigTables();
+
+    // Load textures, from the sprite cache after the first run
+    Uint64 start = SDL_GetPerformanceCounter();
+    if (!gTankTexture.loadRotationSheet("tank.png", ROTATION_STEPS) ||
+        !gEnemyTankTexture.loadRotationSheet("enemy_tank.png", ROTATION_STEPS) ||
         !gBulletTexture.loadFromFile("bullet.png") ||
         !gBackgroundTexture.loadFromFile("background.png")) {
         std::cerr << "Failed to load textures!" << std::endl;
         return false;
     }
+    std::cout << "Loaded textures in " << (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency() << " ms" << std::endl;
 
     // Load sound effects
     gEngineSound = Mix_LoadWAV("engine.wav");
@@ -511,7 +2561,143 @@ void close() {
     SDL_Quit();
 }
 
-int main() {
+// Versus mode: this player against another instance over UDP. Run one
+// with --versus 0 and one with --versus 1, on the same or another host.
+void runVersus(int player, const char* host, int loss) {
+    if (SDLNet_Init() < 0) {
+        std::cerr << "SDL_net could not initialize! SDL_net Error: " << SDLNet_GetError() << std::endl;
+        return;
+    }
+    {
+        AABBTree walls;
+        walls.build(loadWalls("level1.txt"));
+        std::vector<int> visibleWalls;
+        std::vector<SDL_Rect> wallRects;
+        SDL_Rect screen = { 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT };
+
+        RollbackSession session(player, walls);
+        session.setLoss(loss);
+        bool quit = !session.connect(host);
+        SDL_Event e;
+
+        // Game loop, one fixed tick per frame
+        while (!quit) {
+            Uint32 tickStart = SDL_GetTicks();
+
+            // Handle events
+            while (SDL_PollEvent(&e) != 0) {
+                if (e.type == SDL_QUIT) {
+                    quit = true;
+                }
+            }
+
+            // Sample the held keys as this frame's input
+            const Uint8* keys = SDL_GetKeyboardState(nullptr);
+            Uint8 input = 0;
+            input |= keys[SDL_SCANCODE_UP] ? INPUT_UP : 0;
+            input |= keys[SDL_SCANCODE_DOWN] ? INPUT_DOWN : 0;
+            input |= keys[SDL_SCANCODE_LEFT] ? INPUT_LEFT : 0;
+            input |= keys[SDL_SCANCODE_RIGHT] ? INPUT_RIGHT : 0;
+            input |= keys[SDL_SCANCODE_SPACE] ? INPUT_FIRE : 0;
+            session.update(input);
+            const VersusState& state = session.getState();
+
+            // Clear screen
+            SDL_RenderClear(gRenderer);
+
+            // Render background
+            gBackgroundTexture.render(0, 0);
+
+            // Render the walls on screen in one batch
+            visibleWalls.clear();
+            walls.query(screen, visibleWalls);
+            wallRects.clear();
+            for (int index : visibleWalls) {
+                wallRects.push_back(walls.getWall(index));
+            }
+            SDL_SetRenderDrawColor(gRenderer, 0x60, 0x60, 0x60, 0xFF);
+            SDL_RenderFillRects(gRenderer, wallRects.data(), (int)wallRects.size());
+
+            // Render the tanks, the remote one tinted red, and the bullets
+            for (int i = 0; i < 2; ++i) {
+                Uint8 shade = i == player ? 0xFF : 0x80;
+                gTankTexture.setColor(0xFF, shade, shade);
+                state.tanks[i].render();
+            }
+            gTankTexture.setColor(0xFF, 0xFF, 0xFF);
+            for (int i = 0; i < state.bulletCount; ++i) {
+                state.bullets[i].render();
+            }
+
+            // Update screen
+            SDL_RenderPresent(gRenderer);
+
+            // Hold the tick rate both peers simulate at
+            Uint32 elapsed = SDL_GetTicks() - tickStart;
+            if (elapsed < (Uint32)VERSUS_TICK_MS) {
+                SDL_Delay(VERSUS_TICK_MS - elapsed);
+            }
+        }
+
+        const VersusState& state = session.getState();
+        const RollbackStats& stats = session.getStats();
+        std::cout << "Score " << state.score[0] << " - " << state.score[1] << " after " << state.frame << " frames" << std::endl;
+        std::cout << stats.rollbacks << " rollbacks, " << stats.resimFrames << " frames re-simulated (deepest " << stats.maxDepth << ", "
+                  << stats.resimMs << " ms in all), " << stats.stalls << " stalls" << std::endl;
+    }
+    SDLNet_Quit();
+}
+
+int main(int argc, char* argv[]) {
+    // Check for benchmark modes and the enemy and thread counts
+    bool benchRotation = false;
+    int enemyCount = DEFAULT_ENEMY_COUNT;
+    int threadCount = SDL_GetCPUCount();
+    int versusPlayer = -1;
+    const char* versusHost = "localhost";
+    int versusLoss = 0;
+    int simHz = DEFAULT_SIM_HZ;
+    double headlessSeconds = 0.0;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--bench-rotation") == 0) {
+            benchRotation = true;
+        } else if (strcmp(argv[i], "--bench-walls") == 0) {
+            // Needs no window, so run it before SDL starts
+            benchmarkWalls(i + 1 < argc ? argv[i + 1] : nullptr);
+            return 0;
+        } else if (strcmp(argv[i], "--bench-sat") == 0) {
+            benchmarkSAT();
+            return 0;
+        } else if (strcmp(argv[i], "--bench-rollback") == 0) {
+            benchmarkRollback();
+            return 0;
+        } else if (strcmp(argv[i], "--versus") == 0 && i + 1 < argc) {
+            versusPlayer = std::min(1, std::max(0, atoi(argv[++i])));
+            if (i + 1 < argc && argv[i + 1][0] != '-') {
+                versusHost = argv[++i];
+            }
+        } else if (strcmp(argv[i], "--loss") == 0 && i + 1 < argc) {
+            versusLoss = std::max(0, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--bench-ai") == 0) {
+            benchmarkAI(i + 1 < argc ? std::max(1, atoi(argv[i + 1])) : 500);
+            return 0;
+        } else if (strcmp(argv[i], "--enemies") == 0 && i + 1 < argc) {
+            enemyCount = std::max(0, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threadCount = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--sim-hz") == 0 && i + 1 < argc) {
+            simHz = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--headless") == 0) {
+            headlessSeconds = i + 1 < argc && argv[i + 1][0] != '-' ? atof(argv[++i]) : 60.0;
+        }
+    }
+
+    // Headless runs need no window
+    if (headlessSeconds > 0.0) {
+        runHeadless(headlessSeconds, simHz, threadCount, enemyCount);
+        return 0;
+    }
+
     // Start up SDL and create window
     if (!init()) {
         std::cerr << "Failed to initialize!" << std::endl;
@@ -519,17 +2705,23 @@ int main() {
         // Load media
         if (!loadMedia()) {
             std::cerr << "Failed to load media!" << std::endl;
+        } else if (benchRotation) {
+            benchmarkRotation();
+        } else if (versusPlayer >= 0) {
+            runVersus(versusPlayer, versusHost, versusLoss);
         } else {
-            // Create player tank
-            Tank player;
-            std::vector<SDL_Rect> colliders; // List of colliders in the game
-
-            // Create enemy tank
-            EnemyTank enemy(100, 100);
+            World world(threadCount, enemyCount);
+            TickProfiler profiler;
+            double tickSeconds = 1.0 / simHz;
+            double accumulator = 0.0;
+            Uint64 frequency = SDL_GetPerformanceFrequency();
+            Uint64 previous = SDL_GetPerformanceCounter();
+            Uint64 profileStart = previous;
             bool quit = false;
             SDL_Event e;
 
-            // Game loop
+            // Game loop: the simulation runs in fixed ticks however fast
+            // frames are drawn
             while (!quit) {
                 // Handle events
                 while (SDL_PollEvent(&e) != 0) {
@@ -538,27 +2730,36 @@ int main() {
                     }
 
                     // Handle player input
-                    player.handleEvent(e);
+                    world.handleEvent(e);
                 }
 
-                // Move player tank
-                player.move(colliders);
-
-                // Move enemy tank
-                enemy.move(player);
-
-                // Clear screen
-                SDL_RenderClear(gRenderer);
-
-                // Render background
-                gBackgroundTexture.render(0, 0);
+                // Bank the time since the last frame, capped so a long stall
+                // cannot leave the simulation ever further behind
+                Uint64 now = SDL_GetPerformanceCounter();
+                accumulator += std::min((double)(now - previous) / frequency, MAX_FRAME_TIME);
+                previous = now;
+
+                // Run as many ticks as the banked time covers
+                while (accumulator >= tickSeconds) {
+                    profiler.begin();
+                    world.tick((float)tickSeconds);
+                    profiler.end();
+                    world.playSounds();
+                    accumulator -= tickSeconds;
+                }
 
-                // Render the tanks
-                player.render();
-                enemy.render();
+                // Show the tick rate and cost once a second
+                if (now - profileStart >= frequency) {
+                    std::ostringstream title;
+                    title << "Tank Game - " << profiler.getTicks() << " ticks/s, " << profiler.getAverageMs() << " ms avg, "
+                          << profiler.getMaxMs() << " ms max per tick";
+                    SDL_SetWindowTitle(gWindow, title.str().c_str());
+                    profiler.reset();
+                    profileStart = now;
+                }
 
-                // Update screen
-                SDL_RenderPresent(gRenderer);
+                // Draw between the last two ticks
+                world.render((float)(accumulator / tickSeconds));
             }
         }
     }
@@ -3,6 +3,8 @@
 #include <SDL2/SDL_mixer.h>
 #include <iostream>
 #include <vector>
+#include <string>
+#include <cstring>
 #include <cmath>
 #include <algorithm>
 
@@ -32,16 +34,37 @@ const int JEEP_WIDTH = 40;
 const int JEEP_HEIGHT = 20;
 const int JEEP_SPEED = 3;
 
+// Sprite cache settings (cache files sit next to their images)
+const Uint32 TEXTURE_CACHE_MAGIC = 0x32435854;  // "TXC2"
+const char* const TEXTURE_CACHE_SUFFIX = ".cache";
+
+// Header of a sprite cache file. The pixels follow it, premultiplied by
+// alpha and in the renderer's texture format, so they upload as they are.
+struct TextureCacheHeader {
+    Uint32 magic;
+    Uint32 format;                   // SDL pixel format of the pixels
+    Sint32 width, height;            // Of the pixels, in rows of width * 4 bytes
+    Sint32 imageWidth, imageHeight;  // Of the sprite as drawn
+    Uint32 sourceHash;               // hashFile of the image it was made from
+    Uint32 checksum;                 // Of the pixels
+};
+
 // Function declarations
 bool init();
-bool loadMedia();
+bool loadMedia(int threads);
 void close();
 bool checkCollision(SDL_Rect a, SDL_Rect b);
+Uint32 hashFile(std::string path);
+Uint32 checksumPixels(const Uint8* pixels, size_t size);
 
 // SDL objects
 SDL_Window* gWindow = nullptr;
 SDL_Renderer* gRenderer = nullptr;
 
+// The renderer's texture format and blend mode for premultiplied sprites
+Uint32 gTextureFormat = SDL_PIXELFORMAT_ARGB8888;
+SDL_BlendMode gPremultipliedBlend = SDL_BLENDMODE_BLEND;
+
 // Texture wrapper class
 class LTexture {
 public:
@@ -49,6 +72,27 @@ public:
     ~LTexture();
 
     bool loadFromFile(std::string path);
+
+    // Decodes an image and color keys it, without touching the renderer,
+    // so it can run on any thread. Returns nullptr on failure.
+    static SDL_Surface* decodeFile(std::string path);
+
+    // Uploads a decoded image; on the main thread only
+    bool loadFromSurface(SDL_Surface* surface, std::string path);
+
+    // Reads a sprite cache file in a single read, checking that it is whole
+    // and was made from a source image of the given size
+    static bool readCache(std::string path, Uint32 sourceHash, std::vector<Uint8>& cache);
+
+    // Converts a color-keyed image into sprite cache data
+    static bool buildCache(SDL_Surface* surface, Uint32 sourceHash, std::vector<Uint8>& cache);
+
+    // Saves sprite cache data
+    static bool writeCache(std::string path, const std::vector<Uint8>& cache);
+
+    // Uploads sprite cache data with no conversion; on the main thread only
+    bool loadFromCache(const std::vector<Uint8>& cache, std::string path);
+
     void free();
     void render(int x, int y, SDL_Rect* clip = nullptr, double angle = 0.0, SDL_Point* center = nullptr, SDL_RendererFlip flip = SDL_FLIP_NONE);
     int getWidth();
@@ -172,6 +216,41 @@ private:
     bool alive;
 };
 
+// Loads images and sounds at startup. Worker threads decode the files
+// (images to surfaces, sounds to PCM chunks) while the calling thread
+// uploads each image to the renderer as soon as it is decoded.
+class AssetLoader {
+public:
+    // Queues an image or a sound to load
+    void addImage(std::string path, LTexture* texture);
+    void addSound(std::string path, Mix_Chunk** sound);
+
+    // Loads everything queued on up to threads workers, logging the time
+    // each asset took and the total. Returns whether all of them loaded.
+    bool run(int threads);
+
+private:
+    struct Job {
+        std::string path;
+        LTexture* texture;
+        Mix_Chunk** sound;
+        SDL_Surface* surface;  // Decoded image, uploaded by the caller
+        std::vector<Uint8> cache;  // Or its sprite cache data
+        bool cached;           // Whether the cache file could be used
+        Mix_Chunk* chunk;
+        std::string error;
+        double decodeMs;
+    };
+
+    static int threadMain(void* data);
+
+    std::vector<Job> mJobs;
+    SDL_atomic_t mNext;      // Next job for a worker to take
+    SDL_mutex* mLock;        // Guards mFinished
+    SDL_sem* mFinishedCount;
+    std::vector<int> mFinished;
+};
+
 // Globally used textures
 LTexture gHelicopterTexture;
 LTexture gJeepTexture;
@@ -197,39 +276,160 @@ LTexture::~LTexture() {
 }
 
 bool LTexture::loadFromFile(std::string path) {
-    // Get rid of preexisting texture
-    free();
-
-    // The final texture
-    SDL_Texture* newTexture = nullptr;
+    // Use the sprite cache if it is current
+    std::string cachePath = path + TEXTURE_CACHE_SUFFIX;
+    Uint32 sourceHash = hashFile(path);
+    std::vector<Uint8> cache;
+    if (readCache(cachePath, sourceHash, cache)) {
+        return loadFromCache(cache, cachePath);
+    }
 
     // Load image at specified path
-    SDL_Surface* loadedSurface = IMG_Load(path.c_str());
+    SDL_Surface* loadedSurface = decodeFile(path);
     if (loadedSurface == nullptr) {
         std::cerr << "Unable to load image " << path << "! SDL_image Error: " << IMG_GetError() << std::endl;
-    } else {
+        free();
+        return false;
+    }
+
+    // Cache it for next time
+    if (buildCache(loadedSurface, sourceHash, cache)) {
+        SDL_FreeSurface(loadedSurface);
+        writeCache(cachePath, cache);
+        return loadFromCache(cache, cachePath);
+    }
+    return loadFromSurface(loadedSurface, path);
+}
+
+SDL_Surface* LTexture::decodeFile(std::string path) {
+    SDL_Surface* loadedSurface = IMG_Load(path.c_str());
+    if (loadedSurface != nullptr) {
         // Color key image
         SDL_SetColorKey(loadedSurface, SDL_TRUE, SDL_MapRGB(loadedSurface->format, 0, 0xFF, 0xFF));
+    }
+    return loadedSurface;
+}
 
-        // Create texture from surface pixels
-        newTexture = SDL_CreateTextureFromSurface(gRenderer, loadedSurface);
-        if (newTexture == nullptr) {
-            std::cerr << "Unable to create texture from " << path << "! SDL Error: " << SDL_GetError() << std::endl;
-        } else {
-            // Get image dimensions
-            mWidth = loadedSurface->w;
-            mHeight = loadedSurface->h;
-        }
+bool LTexture::loadFromSurface(SDL_Surface* surface, std::string path) {
+    // Get rid of preexisting texture
+    free();
 
-        // Get rid of old loaded surface
-        SDL_FreeSurface(loadedSurface);
+    // Create texture from surface pixels
+    SDL_Texture* newTexture = SDL_CreateTextureFromSurface(gRenderer, surface);
+    if (newTexture == nullptr) {
+        std::cerr << "Unable to create texture from " << path << "! SDL Error: " << SDL_GetError() << std::endl;
+    } else {
+        // Get image dimensions
+        mWidth = surface->w;
+        mHeight = surface->h;
     }
 
+    // Get rid of old loaded surface
+    SDL_FreeSurface(surface);
+
     // Return success
     mTexture = newTexture;
     return mTexture != nullptr;
 }
 
+bool LTexture::readCache(std::string path, Uint32 sourceHash, std::vector<Uint8>& cache) {
+    SDL_RWops* file = SDL_RWFromFile(path.c_str(), "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    Sint64 size = SDL_RWsize(file);
+    bool read = size >= (Sint64)sizeof(TextureCacheHeader);
+    if (read) {
+        cache.resize((size_t)size);
+        read = SDL_RWread(file, cache.data(), cache.size(), 1) == 1;
+    }
+    SDL_RWclose(file);
+    if (!read) {
+        return false;
+    }
+
+    // Check it matches this renderer and the source image, and is intact
+    TextureCacheHeader header;
+    memcpy(&header, cache.data(), sizeof(header));
+    size_t pixelSize = (size_t)header.width * header.height * 4;
+    return header.magic == TEXTURE_CACHE_MAGIC && header.format == gTextureFormat && header.sourceHash == sourceHash &&
+           header.width > 0 && header.height > 0 && cache.size() == sizeof(header) + pixelSize &&
+           checksumPixels(cache.data() + sizeof(header), pixelSize) == header.checksum;
+}
+
+bool LTexture::buildCache(SDL_Surface* surface, Uint32 sourceHash, std::vector<Uint8>& cache) {
+    // Convert to the renderer's format; only 32-bit formats are cached
+    SDL_Surface* converted = SDL_ConvertSurfaceFormat(surface, gTextureFormat, 0);
+    if (converted == nullptr) {
+        return false;
+    }
+    if (converted->format->BytesPerPixel != 4) {
+        SDL_FreeSurface(converted);
+        return false;
+    }
+    TextureCacheHeader header = { TEXTURE_CACHE_MAGIC, gTextureFormat, converted->w, converted->h, surface->w, surface->h, sourceHash, 0 };
+    size_t rowSize = (size_t)converted->w * 4;
+    cache.resize(sizeof(header) + rowSize * converted->h);
+    Uint8* pixels = cache.data() + sizeof(header);
+
+    // Premultiply by alpha, with the color key (cyan) fully transparent
+    SDL_LockSurface(converted);
+    for (int y = 0; y < converted->h; ++y) {
+        const Uint32* in = (const Uint32*)((const Uint8*)converted->pixels + y * converted->pitch);
+        Uint32* out = (Uint32*)(pixels + y * rowSize);
+        for (int x = 0; x < converted->w; ++x) {
+            Uint8 r, g, b, a;
+            SDL_GetRGBA(in[x], converted->format, &r, &g, &b, &a);
+            if (r == 0 && g == 0xFF && b == 0xFF) {
+                a = 0;
+            }
+            out[x] = SDL_MapRGBA(converted->format, r * a / 255, g * a / 255, b * a / 255, a);
+        }
+    }
+    SDL_UnlockSurface(converted);
+    SDL_FreeSurface(converted);
+
+    header.checksum = checksumPixels(pixels, rowSize * header.height);
+    memcpy(cache.data(), &header, sizeof(header));
+    return true;
+}
+
+bool LTexture::writeCache(std::string path, const std::vector<Uint8>& cache) {
+    SDL_RWops* file = SDL_RWFromFile(path.c_str(), "wb");
+    bool written = file != nullptr && SDL_RWwrite(file, cache.data(), cache.size(), 1) == 1;
+    if (file != nullptr) {
+        SDL_RWclose(file);
+    }
+    if (!written) {
+        std::cerr << "Unable to write sprite cache " << path << "! SDL Error: " << SDL_GetError() << std::endl;
+    }
+    return written;
+}
+
+bool LTexture::loadFromCache(const std::vector<Uint8>& cache, std::string path) {
+    // Get rid of preexisting texture
+    free();
+
+    // Upload the pixels as they are
+    TextureCacheHeader header;
+    memcpy(&header, cache.data(), sizeof(header));
+    mTexture = SDL_CreateTexture(gRenderer, header.format, SDL_TEXTUREACCESS_STATIC, header.width, header.height);
+    if (mTexture == nullptr || SDL_UpdateTexture(mTexture, nullptr, cache.data() + sizeof(header), header.width * 4) < 0) {
+        std::cerr << "Unable to create texture from " << path << "! SDL Error: " << SDL_GetError() << std::endl;
+        free();
+        return false;
+    }
+
+    // Sprites are all-or-nothing alpha, so plain blending draws them the
+    // same where the renderer lacks the premultiplied mode
+    if (SDL_SetTextureBlendMode(mTexture, gPremultipliedBlend) < 0) {
+        SDL_SetTextureBlendMode(mTexture, SDL_BLENDMODE_BLEND);
+    }
+    mWidth = header.imageWidth;
+    mHeight = header.imageHeight;
+    return true;
+}
+
 void LTexture::free() {
     // Free texture if it exists
     if (mTexture != nullptr) {
@@ -262,6 +462,119 @@ int LTexture::getHeight() {
     return mHeight;
 }
 
+void AssetLoader::addImage(std::string path, LTexture* texture) {
+    mJobs.push_back({ path, texture, nullptr, nullptr, {}, false, nullptr, "", 0.0 });
+}
+
+void AssetLoader::addSound(std::string path, Mix_Chunk** sound) {
+    mJobs.push_back({ path, nullptr, sound, nullptr, {}, false, nullptr, "", 0.0 });
+}
+
+int AssetLoader::threadMain(void* data) {
+    AssetLoader* loader = static_cast<AssetLoader*>(data);
+    int index;
+    while ((index = SDL_AtomicAdd(&loader->mNext, 1)) < (int)loader->mJobs.size()) {
+        Job& job = loader->mJobs[index];
+        Uint64 start = SDL_GetPerformanceCounter();
+        if (job.texture != nullptr) {
+            // Read the sprite cache, or decode the image and build it
+            std::string cachePath = job.path + TEXTURE_CACHE_SUFFIX;
+            Uint32 sourceHash = hashFile(job.path);
+            job.cached = LTexture::readCache(cachePath, sourceHash, job.cache);
+            if (!job.cached) {
+                job.cache.clear();
+                job.surface = LTexture::decodeFile(job.path);
+                if (job.surface == nullptr) {
+                    job.error = IMG_GetError();
+                } else if (LTexture::buildCache(job.surface, sourceHash, job.cache)) {
+                    SDL_FreeSurface(job.surface);
+                    job.surface = nullptr;
+                    LTexture::writeCache(cachePath, job.cache);
+                }
+            }
+        } else {
+            job.chunk = Mix_LoadWAV(job.path.c_str());
+            if (job.chunk == nullptr) {
+                job.error = Mix_GetError();
+            }
+        }
+        job.decodeMs = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+
+        // Hand the job back to the loading thread
+        SDL_LockMutex(loader->mLock);
+        loader->mFinished.push_back(index);
+        SDL_UnlockMutex(loader->mLock);
+        SDL_SemPost(loader->mFinishedCount);
+    }
+    return 0;
+}
+
+bool AssetLoader::run(int threads) {
+    bool success = true;
+    Uint64 start = SDL_GetPerformanceCounter();
+    double decodeMs = 0.0;
+    double uploadMs = 0.0;
+
+    // Start the workers
+    SDL_AtomicSet(&mNext, 0);
+    mLock = SDL_CreateMutex();
+    mFinishedCount = SDL_CreateSemaphore(0);
+    mFinished.clear();
+    std::vector<SDL_Thread*> workers;
+    threads = std::max(1, std::min(threads, (int)mJobs.size()));
+    for (int i = 0; i < threads; ++i) {
+        SDL_Thread* worker = SDL_CreateThread(threadMain, "AssetLoader", this);
+        if (worker == nullptr) {
+            std::cerr << "Unable to create loader thread! SDL Error: " << SDL_GetError() << std::endl;
+        } else {
+            workers.push_back(worker);
+        }
+    }
+    if (workers.empty()) {
+        // Decode everything here instead
+        threadMain(this);
+    }
+
+    // Upload or store each asset as it comes back
+    for (size_t done = 0; done < mJobs.size(); ++done) {
+        SDL_SemWait(mFinishedCount);
+        SDL_LockMutex(mLock);
+        Job& job = mJobs[mFinished[done]];
+        SDL_UnlockMutex(mLock);
+
+        double jobUploadMs = 0.0;
+        if (!job.error.empty()) {
+            std::cerr << "Unable to load " << job.path << "! Error: " << job.error << std::endl;
+            success = false;
+        } else if (job.texture != nullptr) {
+            Uint64 uploadStart = SDL_GetPerformanceCounter();
+            if (job.surface != nullptr) {
+                success = job.texture->loadFromSurface(job.surface, job.path) && success;
+            } else {
+                success = job.texture->loadFromCache(job.cache, job.path) && success;
+            }
+            jobUploadMs = (SDL_GetPerformanceCounter() - uploadStart) * 1000.0 / SDL_GetPerformanceFrequency();
+        } else {
+            *job.sound = job.chunk;
+        }
+        decodeMs += job.decodeMs;
+        uploadMs += jobUploadMs;
+        std::cout << "Loaded " << job.path << (job.cached ? " from cache" : "") << ": " << job.decodeMs << " ms decoding, " << jobUploadMs << " ms uploading" << std::endl;
+    }
+
+    for (SDL_Thread* worker : workers) {
+        SDL_WaitThread(worker, nullptr);
+    }
+    SDL_DestroySemaphore(mFinishedCount);
+    SDL_DestroyMutex(mLock);
+
+    double totalMs = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+    std::cout << "Loaded " << mJobs.size() << " assets in " << totalMs << " ms on " << threads << " thread(s) ("
+              << decodeMs << " ms decoding, " << uploadMs << " ms uploading in all)" << std::endl;
+    mJobs.clear();
+    return success;
+}
+
 Player::Player(bool isHelicopter) {
     // Initialize the offsets
     mPosX = SCREEN_WIDTH / 2 - PLAYER_WIDTH / 2;
@@ -487,6 +800,19 @@ bool init() {
                 std::cerr << "Renderer could not be created! SDL Error: " << SDL_GetError() << std::endl;
                 success = false;
             } else {
+                // Cache sprites in the first 32-bit format with alpha the renderer takes
+                SDL_RendererInfo info;
+                if (SDL_GetRendererInfo(gRenderer, &info) == 0) {
+                    for (Uint32 i = 0; i < info.num_texture_formats; ++i) {
+                        if (SDL_ISPIXELFORMAT_ALPHA(info.texture_formats[i]) && SDL_BITSPERPIXEL(info.texture_formats[i]) == 32) {
+                            gTextureFormat = info.texture_formats[i];
+                            break;
+                        }
+                    }
+                }
+                gPremultipliedBlend = SDL_ComposeCustomBlendMode(SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD,
+                                                                 SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD);
+
                 // Initialize PNG loading
                 if (!(IMG_Init(IMG_INIT_PNG) & IMG_INIT_PNG)) {
                     std::cerr << "SDL_image could not initialize! SDL_image Error: " << IMG_GetError() << std::endl;
@@ -505,52 +831,18 @@ bool init() {
     return success;
 }
 
-bool loadMedia() {
-    // Loading success flag
-    bool success = true;
-
-    // Load media files
-    if (!gHelicopterTexture.loadFromFile("helicopter.png")) {
-        std::cerr << "Failed to load helicopter texture!" << std::endl;
-        success = false;
-    }
-    if (!gJeepTexture.loadFromFile("jeep.png")) {
-        std::cerr << "Failed to load jeep texture!" << std::endl;
-        success = false;
-    }
-    if (!gEnemyTexture.loadFromFile("enemy.png")) {
-        std::cerr << "Failed to load enemy texture!" << std::endl;
-        success = false;
-    }
-    if (!gBulletTexture.loadFromFile("bullet.png")) {
-        std::cerr << "Failed to load bullet texture!" << std::endl;
-        success = false;
-    }
-    if (!gBackgroundTexture.loadFromFile("background.png")) {
-        std::cerr << "Failed to load background texture!" << std::endl;
-        success = false;
-    }
-
-    // Load sound effects
-    gEngineSound = Mix_LoadWAV("engine.wav");
-    if (gEngineSound == nullptr) {
-        std::cerr << "Failed to load engine sound effect! SDL_mixer Error: " << Mix_GetError() << std::endl;
-        success = false;
-    }
-
-    gShootSound = Mix_LoadWAV("shoot.wav");
-    if (gShootSound == nullptr) {
-        std::cerr << "Failed to load shoot sound effect! SDL_mixer Error: " << Mix_GetError() << std::endl;
-        success = false;
-    }
-
-    gExplosionSound = Mix_LoadWAV("explosion.wav");
-    if (gExplosionSound == nullptr) {
-        std::cerr << "Failed to load explosion sound effect! SDL_mixer Error: " << Mix_GetError() << std::endl;
-        success = false;
-    }
-
-    return success;
+bool loadMedia(int threads) {
+    // Decode every image and sound in parallel
+    AssetLoader loader;
+    loader.addImage("helicopter.png", &gHelicopterTexture);
+    loader.addImage("jeep.png", &gJeepTexture);
+    loader.addImage("enemy.png", &gEnemyTexture);
+    loader.addImage("bullet.png", &gBulletTexture);
+    loader.addImage("background.png", &gBackgroundTexture);
+    loader.addSound("engine.wav", &gEngineSound);
+    loader.addSound("shoot.wav", &gShootSound);
+    loader.addSound("explosion.wav", &gExplosionSound);
+    return loader.run(threads);
 }
 
 void close() {
@@ -578,6 +870,34 @@ void close() {
     SDL_Quit();
 }
 
+// Hashes a file's bytes and size, so any edit to an image invalidates its
+// cache even when the file stays the same size. 0 if it cannot be read.
+Uint32 hashFile(std::string path) {
+    SDL_RWops* file = SDL_RWFromFile(path.c_str(), "rb");
+    if (file == nullptr) {
+        return 0;
+    }
+    Sint64 size = SDL_RWsize(file);
+    std::vector<Uint8> bytes(size > 0 ? (size_t)size + 3 : 0, 0);  // Padded to whole words
+    bool read = size > 0 && SDL_RWread(file, bytes.data(), 1, (size_t)size) == (size_t)size;
+    SDL_RWclose(file);
+    if (!read) {
+        return 0;
+    }
+    return (checksumPixels(bytes.data(), bytes.size()) ^ (Uint32)size) * 16777619u;
+}
+
+// FNV-1a over 32-bit words, so checking a cache costs little next to reading it
+Uint32 checksumPixels(const Uint8* pixels, size_t size) {
+    Uint32 hash = 2166136261u;
+    for (size_t i = 0; i + 4 <= size; i += 4) {
+        Uint32 word;
+        memcpy(&word, pixels + i, 4);
+        hash = (hash ^ word) * 16777619u;
+    }
+    return hash;
+}
+
 bool checkCollision(SDL_Rect a, SDL_Rect b) {
     // The sides of the rectangles
     int leftA = a.x;
@@ -595,12 +915,23 @@ bool checkCollision(SDL_Rect a, SDL_Rect b) {
 }
 
 int main(int argc, char* argv[]) {
+    // Time to the first frame is measured from here
+    Uint64 startup = SDL_GetPerformanceCounter();
+
+    // Check for the number of loader threads
+    int loadThreads = SDL_GetCPUCount();
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--load-threads") == 0 && i + 1 < argc) {
+            loadThreads = std::max(1, atoi(argv[++i]));
+        }
+    }
+
     // Start up SDL and create a window
     if (!init()) {
         std::cerr << "Failed to initialize!" << std::endl;
     } else {
         // Load media
-        if (!loadMedia()) {
+        if (!loadMedia(loadThreads)) {
             std::cerr << "Failed to load media!" << std::endl;
         } else {
             // Main game loop
@@ -613,6 +944,7 @@ int main(int argc, char* argv[]) {
             // Create bullets, enemies, etc.
             std::vector<Bullet> bullets;
             std::vector<Enemy> enemies;
+            bool firstFrame = true;
 
             // Game loop
             while (!quit) {
@@ -674,6 +1006,10 @@ int main(int argc, char* argv[]) {
                     }
                 }
                 SDL_RenderPresent(gRenderer);
+                if (firstFrame) {
+                    std::cout << "First frame after " << (SDL_GetPerformanceCounter() - startup) * 1000.0 / SDL_GetPerformanceFrequency() << " ms" << std::endl;
+                    firstFrame = false;
+                }
 
                 // Remove inactive bullets and enemies
                 bullets.erase(std::remove_if(bullets.begin(), bullets.end(), [](Bullet& b) { return !b.isActive(); }), bullets.end());
@@ -7,6 +7,7 @@
 #include <string>
 #include <sstream>
 #include <algorithm>
+#include <cstring>
 
 // Screen dimensions
 const int SCREEN_WIDTH = 640;
@@ -25,16 +26,32 @@ const int ENEMY_VERTICAL_SPEED = 10;
 // Bullet settings
 const int BULLET_SPEED = 10;
 
+// Sprite cache: <image>.cache holds the image premultiplied in the renderer's format
+const Uint32 TEXTURE_CACHE_MAGIC = 0x32435854;
+const char* const TEXTURE_CACHE_SUFFIX = ".cache";
+
+struct TextureCacheHeader {
+    Uint32 magic;
+    Uint32 format;
+    Sint32 width, height;
+    Uint32 sourceHash;
+    Uint32 checksum;
+};
+
 // Function declarations
 bool init();
 bool loadMedia();
 void close();
 bool checkCollision(SDL_Rect a, SDL_Rect b);
+Uint32 hashFile(const std::string& path);
+Uint32 checksumPixels(const Uint8* pixels, size_t size);
 
 // SDL objects
 SDL_Window* gWindow = nullptr;
 SDL_Renderer* gRenderer = nullptr;
 TTF_Font* gFont = nullptr;
+Uint32 gTextureFormat = SDL_PIXELFORMAT_ARGB8888;
+SDL_BlendMode gPremultipliedBlend = SDL_BLENDMODE_BLEND;
 
 // Texture wrapper class
 class LTexture {
@@ -43,6 +60,9 @@ public:
     ~LTexture();
 
     bool loadFromFile(std::string path);
+    bool loadFromCache(const std::vector<Uint8>& cache, std::string path);
+    static bool readCache(std::string path, Uint32 sourceHash, std::vector<Uint8>& cache);
+    static bool buildCache(SDL_Surface* surface, Uint32 sourceHash, std::vector<Uint8>& cache);
     bool loadFromRenderedText(std::string textureText, SDL_Color textColor);
     void free();
     void render(int x, int y, SDL_Rect* clip = nullptr, double angle = 0.0, SDL_Point* center = nullptr, SDL_RendererFlip flip = SDL_FLIP_NONE);
@@ -139,6 +159,12 @@ LTexture::~LTexture() {
 }
 
 bool LTexture::loadFromFile(std::string path) {
+    std::string cachePath = path + TEXTURE_CACHE_SUFFIX;
+    Uint32 sourceHash = hashFile(path);
+    std::vector<Uint8> cache;
+    if (readCache(cachePath, sourceHash, cache)) {
+        return loadFromCache(cache, cachePath);
+    }
     free();
     SDL_Texture* newTexture = nullptr;
     SDL_Surface* loadedSurface = IMG_Load(path.c_str());
@@ -146,6 +172,17 @@ bool LTexture::loadFromFile(std::string path) {
         std::cerr << "Unable to load image " << path << "! SDL_image Error: " << IMG_GetError() << std::endl;
     } else {
         SDL_SetColorKey(loadedSurface, SDL_TRUE, SDL_MapRGB(loadedSurface->format, 0, 0xFF, 0xFF));
+        if (buildCache(loadedSurface, sourceHash, cache)) {
+            SDL_FreeSurface(loadedSurface);
+            SDL_RWops* file = SDL_RWFromFile(cachePath.c_str(), "wb");
+            if (file == nullptr || SDL_RWwrite(file, cache.data(), cache.size(), 1) != 1) {
+                std::cerr << "Unable to write sprite cache " << cachePath << "! SDL Error: " << SDL_GetError() << std::endl;
+            }
+            if (file != nullptr) {
+                SDL_RWclose(file);
+            }
+            return loadFromCache(cache, cachePath);
+        }
         newTexture = SDL_CreateTextureFromSurface(gRenderer, loadedSurface);
         if (newTexture == nullptr) {
             std::cerr << "Unable to create texture from " << path << "! SDL Error: " << SDL_GetError() << std::endl;
@@ -159,6 +196,80 @@ bool LTexture::loadFromFile(std::string path) {
     return mTexture != nullptr;
 }
 
+bool LTexture::loadFromCache(const std::vector<Uint8>& cache, std::string path) {
+    free();
+    TextureCacheHeader header;
+    memcpy(&header, cache.data(), sizeof(header));
+    mTexture = SDL_CreateTexture(gRenderer, header.format, SDL_TEXTUREACCESS_STATIC, header.width, header.height);
+    if (mTexture == nullptr || SDL_UpdateTexture(mTexture, nullptr, cache.data() + sizeof(header), header.width * 4) < 0) {
+        std::cerr << "Unable to create texture from " << path << "! SDL Error: " << SDL_GetError() << std::endl;
+        free();
+        return false;
+    }
+    if (SDL_SetTextureBlendMode(mTexture, gPremultipliedBlend) < 0) {
+        SDL_SetTextureBlendMode(mTexture, SDL_BLENDMODE_BLEND);
+    }
+    mWidth = header.width;
+    mHeight = header.height;
+    return true;
+}
+
+bool LTexture::readCache(std::string path, Uint32 sourceHash, std::vector<Uint8>& cache) {
+    SDL_RWops* file = SDL_RWFromFile(path.c_str(), "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    Sint64 size = SDL_RWsize(file);
+    bool read = size >= (Sint64)sizeof(TextureCacheHeader);
+    if (read) {
+        cache.resize((size_t)size);
+        read = SDL_RWread(file, cache.data(), cache.size(), 1) == 1;
+    }
+    SDL_RWclose(file);
+    TextureCacheHeader header = {};
+    if (read) {
+        memcpy(&header, cache.data(), sizeof(header));
+    }
+    size_t pixelSize = (size_t)header.width * header.height * 4;
+    bool valid = read && header.magic == TEXTURE_CACHE_MAGIC && header.format == gTextureFormat && header.sourceHash == sourceHash &&
+                 header.width > 0 && header.height > 0 && cache.size() == sizeof(header) + pixelSize &&
+                 checksumPixels(cache.data() + sizeof(header), pixelSize) == header.checksum;
+    if (!valid) {
+        cache.clear();
+    }
+    return valid;
+}
+
+bool LTexture::buildCache(SDL_Surface* surface, Uint32 sourceHash, std::vector<Uint8>& cache) {
+    SDL_Surface* converted = SDL_ConvertSurfaceFormat(surface, gTextureFormat, 0);
+    if (converted == nullptr || converted->format->BytesPerPixel != 4) {
+        SDL_FreeSurface(converted);
+        return false;
+    }
+    TextureCacheHeader header = { TEXTURE_CACHE_MAGIC, gTextureFormat, converted->w, converted->h, sourceHash, 0 };
+    size_t rowSize = (size_t)converted->w * 4;
+    cache.resize(sizeof(header) + rowSize * converted->h);
+    Uint8* pixels = cache.data() + sizeof(header);
+    SDL_LockSurface(converted);
+    for (int y = 0; y < converted->h; ++y) {
+        const Uint32* in = (const Uint32*)((const Uint8*)converted->pixels + y * converted->pitch);
+        Uint32* out = (Uint32*)(pixels + y * rowSize);
+        for (int x = 0; x < converted->w; ++x) {
+            Uint8 r, g, b, a;
+            SDL_GetRGBA(in[x], converted->format, &r, &g, &b, &a);
+            if (r == 0 && g == 0xFF && b == 0xFF) {
+                a = 0; // Color key
+            }
+            out[x] = SDL_MapRGBA(converted->format, r * a / 255, g * a / 255, b * a / 255, a);
+        }
+    }
+    SDL_UnlockSurface(converted);
+    SDL_FreeSurface(converted);
+    header.checksum = checksumPixels(pixels, rowSize * header.height);
+    memcpy(cache.data(), &header, sizeof(header));
+    return true;
+}
+
 bool LTexture::loadFromRenderedText(std::string textureText, SDL_Color textColor) {
     free();
     SDL_Surface* textSurface = TTF_RenderText_Solid(gFont, textureText.c_str(), textColor);
@@ -309,6 +420,17 @@ bool init() {
                 std::cerr << "Renderer could not be created! SDL Error: " << SDL_GetError() << std::endl;
                 success = false;
             } else {
+                SDL_RendererInfo info;
+                if (SDL_GetRendererInfo(gRenderer, &info) == 0) {
+                    for (Uint32 i = 0; i < info.num_texture_formats; ++i) {
+                        if (SDL_ISPIXELFORMAT_ALPHA(info.texture_formats[i]) && SDL_BITSPERPIXEL(info.texture_formats[i]) == 32) {
+                            gTextureFormat = info.texture_formats[i];
+                            break;
+                        }
+                    }
+                }
+                gPremultipliedBlend = SDL_ComposeCustomBlendMode(SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD,
+                                                                 SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD);
                 int imgFlags = IMG_INIT_PNG;
                 if (!(IMG_Init(imgFlags) & imgFlags)) {
                     std::cerr << "SDL_image could not initialize! SDL_image Error: " << IMG_GetError() << std::endl;
@@ -396,6 +518,31 @@ bool checkCollision(SDL_Rect a, SDL_Rect b) {
     return (a.x < b.x + b.w && a.x + a.w > b.x && a.y < b.y + b.h && a.y + a.h > b.y);
 }
 
+Uint32 hashFile(const std::string& path) {
+    SDL_RWops* file = SDL_RWFromFile(path.c_str(), "rb");
+    if (file == nullptr) {
+        return 0;
+    }
+    Sint64 size = SDL_RWsize(file);
+    std::vector<Uint8> bytes(size > 0 ? (size_t)size + 3 : 0, 0);  // Padded to whole words
+    bool read = size > 0 && SDL_RWread(file, bytes.data(), 1, (size_t)size) == (size_t)size;
+    SDL_RWclose(file);
+    if (!read) {
+        return 0;
+    }
+    return (checksumPixels(bytes.data(), bytes.size()) ^ (Uint32)size) * 16777619u;
+}
+
+Uint32 checksumPixels(const Uint8* pixels, size_t size) {
+    Uint32 hash = 2166136261u;
+    for (size_t i = 0; i + 4 <= size; i += 4) {
+        Uint32 word;
+        memcpy(&word, pixels + i, 4);
+        hash = (hash ^ word) * 16777619u;
+    }
+    return hash;
+}
+
 int main(int argc, char* args[]) {
     if (!init()) {
         std::cerr << "Failed to initialize!" << std::endl;
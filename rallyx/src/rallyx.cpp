@@ -1,12 +1,308 @@
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_image.h>
 #include <vector>
+#include <algorithm>
 #include <random>
+#include <cstdlib>
+#include <string>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 const int SCREEN_WIDTH = 640;
 const int SCREEN_HEIGHT = 480;
 const int TILE_SIZE = 32;
 
+// Course size in tiles, four screens each way
+const int COURSE_WIDTH = SCREEN_WIDTH / TILE_SIZE * 4;
+const int COURSE_HEIGHT = SCREEN_HEIGHT / TILE_SIZE * 4;
+const int ROCK_COUNT = 160;
+const int FLAG_COUNT = 10;
+
+// Radar settings, in pixels per tile and from the top-right of the screen
+const int RADAR_SCALE = 2;
+const int RADAR_MARGIN = 8;
+const int RADAR_WIDTH = COURSE_WIDTH * RADAR_SCALE;
+const int RADAR_HEIGHT = COURSE_HEIGHT * RADAR_SCALE;
+
+// Flow field benchmark settings
+const int BENCH_FLOWFIELD_SIZE = 512;
+const int BENCH_FLOWFIELD_UPDATES = 200;
+
+// Flow field value for a tile the player cannot be reached from
+const Uint8 NO_DIRECTION = 0xFF;
+
+// Smoke screen settings; lifetimes are in frames
+const int SMOKE_CAPACITY = 100000;
+const int SMOKE_EMIT_RATE = 6;
+const int SMOKE_LIFETIME = 90;
+const float SMOKE_SPEED = 1.5f;
+const float SMOKE_SPREAD = 0.6f;
+const float SMOKE_DRAG = 0.96f;
+const float SMOKE_SIZE = 16.0f;
+const int SMOKE_STUN_FRAMES = 120;
+
+// Smoke benchmark settings; fewer frames than the lifetime so none expire
+const int BENCH_SMOKE_FRAMES = 60;
+
+// Random number benchmark settings
+const int BENCH_RNG_DRAWS = 10000000;
+
+// Random number generator: xoshiro128**, seeded through splitmix64. A stream
+// number jumps the generator ahead 2^64 draws per stream, so threads can each
+// own a stream that never overlaps another, all reproducible from one seed.
+struct Random {
+  Uint32 state[4];
+
+  void seed(Uint64 seed, int stream = 0) {
+    for (int i = 0; i < 4; ++i) {
+      seed += 0x9E3779B97F4A7C15ull;
+      Uint64 z = seed;
+      z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+      z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+      state[i] = (Uint32)((z ^ (z >> 31)) >> 32);
+    }
+    for (int i = 0; i < stream; ++i) {
+      jump();
+    }
+  }
+
+  Uint32 next() {
+    Uint32 result = rotate(state[1] * 5, 7) * 9;
+    Uint32 t = state[1] << 9;
+    state[2] ^= state[0];
+    state[3] ^= state[1];
+    state[1] ^= state[2];
+    state[0] ^= state[3];
+    state[2] ^= t;
+    state[3] = rotate(state[3], 11);
+    return result;
+  }
+
+  // Advances the generator 2^64 draws
+  void jump() {
+    const Uint32 jumps[] = { 0x8764000b, 0xf542d2d3, 0x6fa035c3, 0x77f2db5b };
+    Uint32 s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    for (Uint32 jump : jumps) {
+      for (int b = 0; b < 32; ++b) {
+        if (jump & (1u << b)) {
+          s0 ^= state[0];
+          s1 ^= state[1];
+          s2 ^= state[2];
+          s3 ^= state[3];
+        }
+        next();
+      }
+    }
+    state[0] = s0;
+    state[1] = s1;
+    state[2] = s2;
+    state[3] = s3;
+  }
+
+  // Unbiased number in [0, range) by Lemire's multiply-shift. The division
+  // that rejects the biased values is only reached when the low half of the
+  // product is below range, which for small ranges is almost never.
+  Uint32 below(Uint32 range) {
+    Uint64 product = (Uint64)next() * range;
+    Uint32 low = (Uint32)product;
+    if (low < range) {
+      Uint32 threshold = (0u - range) % range;
+      while (low < threshold) {
+        product = (Uint64)next() * range;
+        low = (Uint32)product;
+      }
+    }
+    return (Uint32)(product >> 32);
+  }
+
+  // Number in [min, max]
+  int between(int min, int max) {
+    return min + (int)below((Uint32)(max - min) + 1);
+  }
+
+  // Number in [0, 1)
+  float unit() {
+    return (next() >> 8) * (1.0f / 16777216.0f);
+  }
+
+  static Uint32 rotate(Uint32 x, int k) {
+    return (x << k) | (x >> (32 - k));
+  }
+};
+
+Random gRandom;
+
+// Occupancy layers of the tile grid
+enum Layer {
+  LAYER_WALL,
+  LAYER_ROCK,
+  LAYER_FLAG,
+  LAYER_SMOKE,  // Rebuilt from the smoke particles every frame
+  LAYER_COUNT
+};
+
+// Tile grid with one bit per cell in each occupancy layer. Rows are padded to
+// whole 64-bit words so a row of a layer can be scanned a word at a time.
+struct TileGrid {
+  int width;
+  int height;
+  int wordsPerRow;
+  std::vector<Uint64> bits;
+
+  void resize(int w, int h) {
+    width = w;
+    height = h;
+    wordsPerRow = (w + 63) / 64;
+    bits.assign((size_t)LAYER_COUNT * height * wordsPerRow, 0);
+  }
+
+  Uint64* row(int layer, int y) {
+    return &bits[((size_t)layer * height + y) * wordsPerRow];
+  }
+
+  const Uint64* row(int layer, int y) const {
+    return &bits[((size_t)layer * height + y) * wordsPerRow];
+  }
+
+  // Cells outside the grid read as wall
+  bool test(int layer, int x, int y) const {
+    if (x < 0 || y < 0 || x >= width || y >= height) {
+      return layer == LAYER_WALL;
+    }
+    return (row(layer, y)[x >> 6] >> (x & 63)) & 1;
+  }
+
+  void set(int layer, int x, int y) {
+    row(layer, y)[x >> 6] |= (Uint64)1 << (x & 63);
+  }
+
+  void clear(int layer, int x, int y) {
+    row(layer, y)[x >> 6] &= ~((Uint64)1 << (x & 63));
+  }
+
+  void clearLayer(int layer) {
+    std::fill(row(layer, 0), row(layer, 0) + (size_t)height * wordsPerRow, 0);
+  }
+
+  bool empty(int x, int y) const {
+    return !test(LAYER_WALL, x, y) && !test(LAYER_ROCK, x, y) && !test(LAYER_FLAG, x, y);
+  }
+
+  // True if any cell under the rectangle is set. A car is at most a tile
+  // wide, so this looks at no more than four cells.
+  bool any(int layer, const SDL_Rect& rect) const {
+    int x0 = rect.x / TILE_SIZE, x1 = (rect.x + rect.w - 1) / TILE_SIZE;
+    int y0 = rect.y / TILE_SIZE, y1 = (rect.y + rect.h - 1) / TILE_SIZE;
+    for (int y = y0; y <= y1; ++y) {
+      for (int x = x0; x <= x1; ++x) {
+        if (test(layer, x, y)) {
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+
+  // Clears the cells under the rectangle, returning how many were set
+  int take(int layer, const SDL_Rect& rect) {
+    int taken = 0;
+    int x0 = rect.x / TILE_SIZE, x1 = (rect.x + rect.w - 1) / TILE_SIZE;
+    int y0 = rect.y / TILE_SIZE, y1 = (rect.y + rect.h - 1) / TILE_SIZE;
+    for (int y = y0; y <= y1; ++y) {
+      for (int x = x0; x <= x1; ++x) {
+        if (x >= 0 && y >= 0 && x < width && y < height && test(layer, x, y)) {
+          clear(layer, x, y);
+          ++taken;
+        }
+      }
+    }
+    return taken;
+  }
+
+  // Appends a tile-sized rectangle, relative to the view, for every set cell
+  // of a layer that the view overlaps. Only the words the view spans are
+  // read, so the cost follows the view size rather than the course size.
+  void collect(int layer, const SDL_Rect& view, std::vector<SDL_Rect>& rects) const {
+    int x0 = std::max(view.x / TILE_SIZE, 0), x1 = std::min((view.x + view.w - 1) / TILE_SIZE, width - 1);
+    int y0 = std::max(view.y / TILE_SIZE, 0), y1 = std::min((view.y + view.h - 1) / TILE_SIZE, height - 1);
+    if (x0 > x1) {
+      return;
+    }
+    for (int y = y0; y <= y1; ++y) {
+      const Uint64* words = row(layer, y);
+      for (int w = x0 >> 6; w <= x1 >> 6; ++w) {
+        Uint64 word = words[w];
+        if (w == x0 >> 6) {
+          word &= ~(Uint64)0 << (x0 & 63);
+        }
+        if (w == x1 >> 6) {
+          word &= ~(Uint64)0 >> (63 - (x1 & 63));
+        }
+        for (; word != 0; word &= word - 1) {
+          int x = w * 64 + __builtin_ctzll(word);
+          rects.push_back({ x * TILE_SIZE - view.x, y * TILE_SIZE - view.y, TILE_SIZE, TILE_SIZE });
+        }
+      }
+    }
+  }
+};
+
+// Flow field towards the player. One breadth-first search from the player's
+// tile over the whole course gives every tile the direction to drive to get
+// closer to the player, so all enemies share one search. The arrays have a
+// one-tile blocked border so the search needs no bounds checks.
+struct FlowField {
+  int width = 0;
+  int height = 0;
+  int stride = 0;
+  int targetX = -1;
+  int targetY = -1;
+  int reached = 0;               // Tiles the player can be reached from
+  std::vector<Uint8> blocked;    // Walls and rocks
+  std::vector<Uint8> direction;  // 0 = up, 1 = right, 2 = down, 3 = left
+  std::vector<int> queue;
+
+  // Rebuilds the field if the player has moved to another tile, returning
+  // whether it did
+  bool update(const TileGrid& grid, int x, int y);
+
+  // Rebuilds the field from the given tile; walls and rocks are impassable
+  void build(const TileGrid& grid, int x, int y);
+
+  Uint8 at(int x, int y) const {
+    return direction[(size_t)(y + 1) * stride + x + 1];
+  }
+};
+
+// Smoke particles in structure-of-arrays form, kept in a ring buffer. They
+// all live equally long, so they expire in the order they were emitted and
+// the live ones are always the run from the oldest onwards.
+struct SmokeParticles {
+  std::vector<float> x, y;    // Centre positions in the course
+  std::vector<float> vx, vy;  // Velocity in pixels per frame
+  std::vector<float> life;    // 1 when emitted, down to 0 when gone
+  std::vector<int> indices;   // Two triangles per particle, built once
+  int capacity = 0;
+  int head = 0;               // Oldest live particle
+  int count = 0;
+
+  void init(int size);
+
+  // Adds a particle, replacing the oldest one when full
+  void emit(float px, float py, float pvx, float pvy);
+
+  // Moves, slows and ages every live particle, then retires expired ones
+  void update();
+
+  // Sets the smoke layer of the grid on every tile holding a particle
+  void markTiles(TileGrid& grid) const;
+
+  // Writes a quad, relative to the view, for every particle in view into
+  // room for capacity quads, returning how many were written
+  int buildVertices(const SDL_Rect& view, SDL_Vertex* vertices) const;
+};
+
 // Player structure
 struct Player {
   SDL_Rect rect;
@@ -21,18 +317,169 @@ struct Enemy {
   int speed;
   int direction;
   bool active;
+  int stunned; // Frames left to sit out in the smoke
 };
 
-// Flag structure
-struct Flag {
-  SDL_Rect rect;
-  bool collected;
-};
+bool FlowField::update(const TileGrid& grid, int x, int y) {
+  if (x == targetX && y == targetY && width == grid.width && height == grid.height) {
+    return false;
+  }
+  build(grid, x, y);
+  return true;
+}
 
-// Rock structure
-struct Rock {
-  SDL_Rect rect;
-};
+void FlowField::build(const TileGrid& grid, int x, int y) {
+  if (width != grid.width || height != grid.height) {
+    width = grid.width;
+    height = grid.height;
+    stride = width + 2;
+    blocked.assign((size_t)stride * (height + 2), 1);
+    direction.resize(blocked.size());
+    queue.resize((size_t)width * height);
+  }
+  targetX = x;
+  targetY = y;
+  reached = 0;
+
+  // Unpack walls and rocks a word at a time
+  for (int row = 0; row < height; ++row) {
+    const Uint64* walls = grid.row(LAYER_WALL, row);
+    const Uint64* rocks = grid.row(LAYER_ROCK, row);
+    Uint8* out = &blocked[(size_t)(row + 1) * stride + 1];
+    for (int col = 0; col < width; ++col) {
+      out[col] = ((walls[col >> 6] | rocks[col >> 6]) >> (col & 63)) & 1;
+    }
+  }
+  std::fill(direction.begin(), direction.end(), NO_DIRECTION);
+  if (x < 0 || y < 0 || x >= width || y >= height) {
+    return;
+  }
+
+  // Neighbour offsets, and the direction that leads back from each neighbour
+  const int offset[] = { -stride, 1, stride, -1 };
+  const Uint8 back[] = { 2, 3, 0, 1 };
+
+  int head = 0, tail = 0;
+  int start = (y + 1) * stride + x + 1;
+  queue[tail++] = start;
+  direction[start] = 0;  // Marks it visited
+  while (head < tail) {
+    int cell = queue[head++];
+    for (int d = 0; d < 4; ++d) {
+      int neighbour = cell + offset[d];
+      if (blocked[neighbour] || direction[neighbour] != NO_DIRECTION) {
+        continue;
+      }
+      direction[neighbour] = back[d];
+      queue[tail++] = neighbour;
+    }
+  }
+  // The player's own tile has nowhere to go
+  direction[start] = NO_DIRECTION;
+  reached = tail;
+}
+
+void SmokeParticles::init(int size) {
+  capacity = size;
+  head = 0;
+  count = 0;
+  x.assign(size, 0.0f);
+  y.assign(size, 0.0f);
+  vx.assign(size, 0.0f);
+  vy.assign(size, 0.0f);
+  life.assign(size, 0.0f);
+  indices.resize((size_t)size * 6);
+  for (int i = 0; i < size; ++i) {
+    const int quad[] = { 0, 1, 2, 2, 1, 3 };
+    for (int k = 0; k < 6; ++k) {
+      indices[(size_t)i * 6 + k] = i * 4 + quad[k];
+    }
+  }
+}
+
+void SmokeParticles::emit(float px, float py, float pvx, float pvy) {
+  if (count == capacity) {
+    head = (head + 1) % capacity;
+    --count;
+  }
+  int i = (head + count) % capacity;
+  x[i] = px;
+  y[i] = py;
+  vx[i] = pvx;
+  vy[i] = pvy;
+  life[i] = 1.0f;
+  ++count;
+}
+
+// Integrates particles [begin, end) one frame
+static void updateSmokeSpan(float* x, float* y, float* vx, float* vy, float* life, int begin, int end) {
+  int k = begin;
+#if defined(__SSE2__)
+  const __m128 drag = _mm_set1_ps(SMOKE_DRAG);
+  const __m128 decay = _mm_set1_ps(1.0f / SMOKE_LIFETIME);
+  for (; k + 4 <= end; k += 4) {
+    __m128 velX = _mm_loadu_ps(vx + k);
+    __m128 velY = _mm_loadu_ps(vy + k);
+    _mm_storeu_ps(x + k, _mm_add_ps(_mm_loadu_ps(x + k), velX));
+    _mm_storeu_ps(y + k, _mm_add_ps(_mm_loadu_ps(y + k), velY));
+    _mm_storeu_ps(vx + k, _mm_mul_ps(velX, drag));
+    _mm_storeu_ps(vy + k, _mm_mul_ps(velY, drag));
+    _mm_storeu_ps(life + k, _mm_sub_ps(_mm_loadu_ps(life + k), decay));
+  }
+#endif
+  for (; k < end; ++k) {
+    x[k] += vx[k];
+    y[k] += vy[k];
+    vx[k] *= SMOKE_DRAG;
+    vy[k] *= SMOKE_DRAG;
+    life[k] -= 1.0f / SMOKE_LIFETIME;
+  }
+}
+
+void SmokeParticles::update() {
+  // The live run wraps at most once around the end of the arrays
+  int end = head + count;
+  updateSmokeSpan(x.data(), y.data(), vx.data(), vy.data(), life.data(), head, std::min(end, capacity));
+  if (end > capacity) {
+    updateSmokeSpan(x.data(), y.data(), vx.data(), vy.data(), life.data(), 0, end - capacity);
+  }
+  while (count > 0 && life[head] <= 0.0f) {
+    head = (head + 1) % capacity;
+    --count;
+  }
+}
+
+void SmokeParticles::markTiles(TileGrid& grid) const {
+  grid.clearLayer(LAYER_SMOKE);
+  for (int n = 0, i = head; n < count; ++n, i = i + 1 == capacity ? 0 : i + 1) {
+    int tx = (int)x[i] / TILE_SIZE, ty = (int)y[i] / TILE_SIZE;
+    if (x[i] >= 0.0f && y[i] >= 0.0f && tx < grid.width && ty < grid.height) {
+      grid.set(LAYER_SMOKE, tx, ty);
+    }
+  }
+}
+
+int SmokeParticles::buildVertices(const SDL_Rect& view, SDL_Vertex* vertices) const {
+  SDL_Vertex* out = vertices;
+  const float left = (float)view.x - SMOKE_SIZE, right = (float)(view.x + view.w) + SMOKE_SIZE;
+  const float top = (float)view.y - SMOKE_SIZE, bottom = (float)(view.y + view.h) + SMOKE_SIZE;
+  for (int n = 0, i = head; n < count; ++n, i = i + 1 == capacity ? 0 : i + 1) {
+    if (x[i] < left || x[i] > right || y[i] < top || y[i] > bottom) {
+      continue;
+    }
+
+    // Puffs grow to twice their size as they fade out
+    float half = SMOKE_SIZE * (2.0f - life[i]) * 0.5f;
+    float cx = x[i] - view.x, cy = y[i] - view.y;
+    SDL_Color color = { 0xFF, 0xFF, 0xFF, (Uint8)(life[i] * 255.0f) };
+    out[0] = { { cx - half, cy - half }, color, { 0.0f, 0.0f } };
+    out[1] = { { cx + half, cy - half }, color, { 1.0f, 0.0f } };
+    out[2] = { { cx - half, cy + half }, color, { 0.0f, 1.0f } };
+    out[3] = { { cx + half, cy + half }, color, { 1.0f, 1.0f } };
+    out += 4;
+  }
+  return (int)(out - vertices) / 4;
+}
 
 // Function to load a texture
 SDL_Texture* loadTexture(SDL_Renderer* renderer, const std::string& path) {
@@ -48,13 +495,201 @@ SDL_Texture* loadTexture(SDL_Renderer* renderer, const std::string& path) {
 
 // Function to generate random number between min and max (inclusive)
 int getRandomNumber(int min, int max) {
-  static std::random_device rd;
-  static std::mt19937 gen(rd());
-  std::uniform_int_distribution<> distrib(min, max);
-  return distrib(gen);
+  return gRandom.between(min, max);
+}
+
+// Function to build the course: a border wall, blocks of wall laid out like
+// city streets, then rocks and flags on random empty tiles away from the start
+void generateCourse(TileGrid& grid, int width, int height, int rocks, int flags, int startX, int startY) {
+  grid.resize(width, height);
+  for (int y = 0; y < grid.height; ++y) {
+    for (int x = 0; x < grid.width; ++x) {
+      bool border = x == 0 || y == 0 || x == grid.width - 1 || y == grid.height - 1;
+      bool block = x % 4 >= 2 && y % 4 >= 2;
+      if (border || block) {
+        grid.set(LAYER_WALL, x, y);
+      }
+    }
+  }
+
+  const int layers[] = { LAYER_ROCK, LAYER_FLAG };
+  const int counts[] = { rocks, flags };
+  for (int i = 0; i < 2; ++i) {
+    for (int placed = 0; placed < counts[i];) {
+      int x = getRandomNumber(1, grid.width - 2);
+      int y = getRandomNumber(1, grid.height - 2);
+      if (grid.empty(x, y) && (std::abs(x - startX) > 2 || std::abs(y - startY) > 2)) {
+        grid.set(layers[i], x, y);
+        ++placed;
+      }
+    }
+  }
+}
+
+// Function to pick a random tile with nothing on it
+void findEmptyTile(const TileGrid& grid, int& x, int& y) {
+  do {
+    x = getRandomNumber(1, grid.width - 2);
+    y = getRandomNumber(1, grid.height - 2);
+  } while (!grid.empty(x, y));
+}
+
+// Function to time flow field rebuilds on a large course as the player
+// drives along its top street, one rebuild per tile crossed
+int benchmarkFlowField() {
+  TileGrid grid;
+  int size = BENCH_FLOWFIELD_SIZE;
+  generateCourse(grid, size, size, size * size / 50, size * size / 100, 1, 1);
+  FlowField field;
+  field.build(grid, 1, 1);
+
+  int reachable = field.reached;
+
+  Uint64 start = SDL_GetPerformanceCounter();
+  int updates = 0;
+  for (int i = 0; i < BENCH_FLOWFIELD_UPDATES; ++i) {
+    int x = 1 + i % (size - 2);
+    if (!grid.test(LAYER_ROCK, x, 1)) {
+      updates += field.update(grid, x, 1);
+    }
+  }
+  double seconds = (double)(SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+  SDL_Log("Flow field %dx%d, %d reachable tiles: %d updates in %.3f s, %.2f ms each, %.0f updates/s",
+          size, size, reachable, updates, seconds, seconds * 1000.0 / updates, updates / seconds);
+  return 0;
+}
+
+// Function to time the smoke passes with every particle alive and in view
+int benchmarkSmoke() {
+  TileGrid grid;
+  generateCourse(grid, COURSE_WIDTH, COURSE_HEIGHT, ROCK_COUNT, FLAG_COUNT, 1, 1);
+  SDL_Rect course = { 0, 0, COURSE_WIDTH * TILE_SIZE, COURSE_HEIGHT * TILE_SIZE };
+  SmokeParticles smoke;
+  smoke.init(SMOKE_CAPACITY);
+  for (int i = 0; i < SMOKE_CAPACITY; ++i) {
+    smoke.emit(gRandom.unit() * course.w, gRandom.unit() * course.h,
+               (gRandom.unit() * 2.0f - 1.0f) * SMOKE_SPREAD, (gRandom.unit() * 2.0f - 1.0f) * SMOKE_SPREAD);
+  }
+  std::vector<SDL_Vertex> vertices((size_t)SMOKE_CAPACITY * 4);
+  int quads = 0;
+
+  Uint64 updateTicks = 0, markTicks = 0, vertexTicks = 0;
+  for (int frame = 0; frame < BENCH_SMOKE_FRAMES; ++frame) {
+    Uint64 start = SDL_GetPerformanceCounter();
+    smoke.update();
+    Uint64 updated = SDL_GetPerformanceCounter();
+    smoke.markTiles(grid);
+    Uint64 marked = SDL_GetPerformanceCounter();
+    quads = smoke.buildVertices(course, vertices.data());
+    Uint64 built = SDL_GetPerformanceCounter();
+    updateTicks += updated - start;
+    markTicks += marked - updated;
+    vertexTicks += built - marked;
+  }
+  double scale = 1000.0 / SDL_GetPerformanceFrequency() / BENCH_SMOKE_FRAMES;
+  SDL_Log("Smoke, %d live particles, per frame: update %.3f ms, stun grid %.3f ms, vertices %.3f ms (%d quads)",
+          smoke.count, updateTicks * scale, markTicks * scale, vertexTicks * scale, quads);
+  return 0;
+}
+
+// Function to time bounded random numbers from the old mt19937 path, rand()
+// and the xoshiro generator
+int benchmarkRandom() {
+  const int range = 100;
+  Uint64 frequency = SDL_GetPerformanceFrequency();
+  long long sum = 0;
+
+  // What getRandomNumber used to do: a new distribution on every call
+  std::mt19937 gen(1);
+  Uint64 start = SDL_GetPerformanceCounter();
+  for (int i = 0; i < BENCH_RNG_DRAWS; ++i) {
+    std::uniform_int_distribution<> distrib(0, range - 1);
+    sum += distrib(gen);
+  }
+  double mtSeconds = (double)(SDL_GetPerformanceCounter() - start) / frequency;
+
+  // What the other games do, modulo bias and all
+  srand(1);
+  start = SDL_GetPerformanceCounter();
+  for (int i = 0; i < BENCH_RNG_DRAWS; ++i) {
+    sum += rand() % range;
+  }
+  double randSeconds = (double)(SDL_GetPerformanceCounter() - start) / frequency;
+
+  Random random;
+  random.seed(1);
+  start = SDL_GetPerformanceCounter();
+  for (int i = 0; i < BENCH_RNG_DRAWS; ++i) {
+    sum += random.below(range);
+  }
+  double xoshiroSeconds = (double)(SDL_GetPerformanceCounter() - start) / frequency;
+
+  double scale = 1e9 / BENCH_RNG_DRAWS;
+  SDL_Log("%d draws in [0, %d): mt19937 %.2f ns, rand() %.2f ns, xoshiro128** %.2f ns each (checksum %lld)",
+          BENCH_RNG_DRAWS, range, mtSeconds * scale, randSeconds * scale, xoshiroSeconds * scale, sum);
+  return 0;
+}
+
+// Function to move a car one step. If that would put it on a blocking tile,
+// it stops flush against the tile instead and false is returned.
+bool moveCar(SDL_Rect& rect, int direction, int speed, const TileGrid& grid, bool rocksBlock) {
+  switch (direction) {
+    case 0:
+      rect.y -= speed;
+      break;
+    case 1:
+      rect.x += speed;
+      break;
+    case 2:
+      rect.y += speed;
+      break;
+    case 3:
+      rect.x -= speed;
+      break;
+  }
+  if (!grid.any(LAYER_WALL, rect) && !(rocksBlock && grid.any(LAYER_ROCK, rect))) {
+    return true;
+  }
+  switch (direction) {
+    case 0:
+      rect.y = (rect.y / TILE_SIZE + 1) * TILE_SIZE;
+      break;
+    case 1:
+      rect.x = (rect.x + rect.w) / TILE_SIZE * TILE_SIZE - rect.w;
+      break;
+    case 2:
+      rect.y = (rect.y + rect.h) / TILE_SIZE * TILE_SIZE - rect.h;
+      break;
+    case 3:
+      rect.x = (rect.x / TILE_SIZE + 1) * TILE_SIZE;
+      break;
+  }
+  return false;
 }
 
 int main(int argc, char* argv[]) {
+  // Seed from the clock unless a seed is given, and log it so a run can be repeated
+  Uint64 seed = SDL_GetPerformanceCounter();
+  std::string bench;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--seed" && i + 1 < argc) {
+      seed = std::strtoull(argv[++i], nullptr, 10);
+    } else if (arg == "--bench-flowfield" || arg == "--bench-smoke" || arg == "--bench-rng") {
+      bench = arg;
+    }
+  }
+  gRandom.seed(seed);
+  SDL_Log("Seed %llu", (unsigned long long)seed);
+
+  if (bench == "--bench-flowfield") {
+    return benchmarkFlowField();
+  } else if (bench == "--bench-smoke") {
+    return benchmarkSmoke();
+  } else if (bench == "--bench-rng") {
+    return benchmarkRandom();
+  }
+
   // Initialize SDL
   if (SDL_Init(SDL_INIT_VIDEO) < 0) {
     SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Couldn't initialize SDL: %s", SDL_GetError());
@@ -81,42 +716,50 @@ int main(int argc, char* argv[]) {
   SDL_Texture* flagTexture = loadTexture(renderer, "flag.png");
   SDL_Texture* rockTexture = loadTexture(renderer, "rock.png");
   SDL_Texture* smokeTexture = loadTexture(renderer, "smoke.png");
+  SDL_SetTextureBlendMode(smokeTexture, SDL_BLENDMODE_BLEND);
+
+  // Initialize course, starting the player on the top street near the centre
+  int startX = COURSE_WIDTH / 2 / 4 * 4;
+  int startY = 1;
+  TileGrid grid;
+  generateCourse(grid, COURSE_WIDTH, COURSE_HEIGHT, ROCK_COUNT, FLAG_COUNT, startX, startY);
+  FlowField field;
+  int flagsLeft = FLAG_COUNT;
+  std::vector<SDL_Rect> tileRects;
+  SDL_Rect course = { 0, 0, COURSE_WIDTH * TILE_SIZE, COURSE_HEIGHT * TILE_SIZE };
+  SDL_Rect camera = { 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT };
+
+  // Flag dots on the radar, rebuilt only when a flag is collected
+  SDL_Rect radar = { SCREEN_WIDTH - RADAR_WIDTH - RADAR_MARGIN, RADAR_MARGIN, RADAR_WIDTH, RADAR_HEIGHT };
+  std::vector<SDL_Rect> radarFlags;
+  bool radarStale = true;
+
+  // Smoke screen
+  SmokeParticles smoke;
+  smoke.init(SMOKE_CAPACITY);
+  std::vector<SDL_Vertex> smokeVertices((size_t)SMOKE_CAPACITY * 4);
 
   // Initialize player
   Player player;
-  player.rect = { SCREEN_WIDTH / 2 - TILE_SIZE / 2, SCREEN_HEIGHT / 2 - TILE_SIZE / 2, TILE_SIZE, TILE_SIZE };
+  player.rect = { startX * TILE_SIZE, startY * TILE_SIZE, TILE_SIZE, TILE_SIZE };
   player.speed = 3;
-  player.direction = 0;
+  player.direction = 2;
   player.smoke = false;
 
   // Initialize enemies
   std::vector<Enemy> enemies;
   for (int i = 0; i < 4; ++i) {
     Enemy enemy;
-    enemy.rect = { getRandomNumber(0, SCREEN_WIDTH - TILE_SIZE), getRandomNumber(0, SCREEN_HEIGHT - TILE_SIZE), TILE_SIZE, TILE_SIZE };
+    int x, y;
+    findEmptyTile(grid, x, y);
+    enemy.rect = { x * TILE_SIZE, y * TILE_SIZE, TILE_SIZE, TILE_SIZE };
     enemy.speed = 2;
     enemy.direction = getRandomNumber(0, 3);
     enemy.active = true;
+    enemy.stunned = 0;
     enemies.push_back(enemy);
   }
 
-  // Initialize flags
-  std::vector<Flag> flags;
-  for (int i = 0; i < 10; ++i) {
-    Flag flag;
-    flag.rect = { getRandomNumber(0, SCREEN_WIDTH - TILE_SIZE), getRandomNumber(0, SCREEN_HEIGHT - TILE_SIZE), TILE_SIZE, TILE_SIZE };
-    flag.collected = false;
-    flags.push_back(flag);
-  }
-
-  // Initialize rocks
-  std::vector<Rock> rocks;
-  for (int i = 0; i < 20; ++i) {
-    Rock rock;
-    rock.rect = { getRandomNumber(0, SCREEN_WIDTH - TILE_SIZE), getRandomNumber(0, SCREEN_HEIGHT - TILE_SIZE), TILE_SIZE, TILE_SIZE };
-    rocks.push_back(rock);
-  }
-
   // Game loop
   bool quit = false;
   SDL_Event e;
@@ -150,75 +793,64 @@ int main(int argc, char* argv[]) {
       }
     }
 
-    // Move player
-    switch (player.direction) {
-      case 0:
-        player.rect.y -= player.speed;
-        break;
-      case 1:
-        player.rect.x += player.speed;
-        break;
-      case 2:
-        player.rect.y += player.speed;
-        break;
-      case 3:
-        player.rect.x -= player.speed;
-        break;
-    }
+    // Move player, stopping at walls
+    moveCar(player.rect, player.direction, player.speed, grid, false);
 
-    // Keep player within screen bounds
-    if (player.rect.x < 0) {
-      player.rect.x = 0;
-    } else if (player.rect.x > SCREEN_WIDTH - player.rect.w) {
-      player.rect.x = SCREEN_WIDTH - player.rect.w;
-    }
-    if (player.rect.y < 0) {
-      player.rect.y = 0;
-    } else if (player.rect.y > SCREEN_HEIGHT - player.rect.h) {
-      player.rect.y = SCREEN_HEIGHT - player.rect.h;
+    // Lay smoke behind the player and find the tiles it covers
+    if (player.smoke) {
+      const int backX[] = { 0, -1, 0, 1 };
+      const int backY[] = { 1, 0, -1, 0 };
+      float rearX = player.rect.x + player.rect.w * 0.5f * (1 + backX[player.direction]);
+      float rearY = player.rect.y + player.rect.h * 0.5f * (1 + backY[player.direction]);
+      for (int i = 0; i < SMOKE_EMIT_RATE; ++i) {
+        float spreadX = (gRandom.unit() * 2.0f - 1.0f) * SMOKE_SPREAD;
+        float spreadY = (gRandom.unit() * 2.0f - 1.0f) * SMOKE_SPREAD;
+        smoke.emit(rearX, rearY, backX[player.direction] * SMOKE_SPEED + spreadX, backY[player.direction] * SMOKE_SPEED + spreadY);
+      }
     }
+    smoke.update();
+    smoke.markTiles(grid);
 
-    // Move enemies
-    for (auto& enemy : enemies) {
-      if (enemy.active) {
-        switch (enemy.direction) {
-          case 0:
-            enemy.rect.y -= enemy.speed;
-            break;
-          case 1:
-            enemy.rect.x += enemy.speed;
-            break;
-          case 2:
-            enemy.rect.y += enemy.speed;
-            break;
-          case 3:
-            enemy.rect.x -= enemy.speed;
-            break;
-        }
+    // Follow the flow field from the tile under the middle of the player
+    field.update(grid, (player.rect.x + player.rect.w / 2) / TILE_SIZE, (player.rect.y + player.rect.h / 2) / TILE_SIZE);
 
-        // Keep enemies within screen bounds and change direction if they hit a wall
-        if (enemy.rect.x < 0) {
-          enemy.rect.x = 0;
-          enemy.direction = getRandomNumber(0, 1) ? 1 : 2; // Right or down
-        } else if (enemy.rect.x > SCREEN_WIDTH - enemy.rect.w) {
-          enemy.rect.x = SCREEN_WIDTH - enemy.rect.w;
-          enemy.direction = getRandomNumber(0, 1) ? 3 : 2; // Left or down
-        }
-        if (enemy.rect.y < 0) {
-          enemy.rect.y = 0;
-          enemy.direction = getRandomNumber(0, 1) ? 1 : 3; // Right or left
-        } else if (enemy.rect.y > SCREEN_HEIGHT - enemy.rect.h) {
-          enemy.rect.y = SCREEN_HEIGHT - enemy.rect.h;
-          enemy.direction = getRandomNumber(0, 1) ? 1 : 3; // Right or left
+    // Move enemies, steering by the flow field whenever they line up with a
+    // tile, and turn to a random side if they still hit a wall or rock.
+    // Enemies that drive into smoke are stunned for a while.
+    for (auto& enemy : enemies) {
+      if (!enemy.active) {
+        continue;
+      }
+      if (enemy.stunned == 0 && grid.any(LAYER_SMOKE, enemy.rect)) {
+        enemy.stunned = SMOKE_STUN_FRAMES;
+      }
+      if (enemy.stunned > 0) {
+        --enemy.stunned;
+        continue;
+      }
+      if (enemy.rect.x % TILE_SIZE == 0 && enemy.rect.y % TILE_SIZE == 0) {
+        Uint8 direction = field.at(enemy.rect.x / TILE_SIZE, enemy.rect.y / TILE_SIZE);
+        if (direction != NO_DIRECTION) {
+          enemy.direction = direction;
         }
       }
+      if (!moveCar(enemy.rect, enemy.direction, enemy.speed, grid, true)) {
+        enemy.direction = (enemy.direction + (getRandomNumber(0, 1) ? 1 : 3)) % 4;
+      }
     }
 
-    // Check for collisions
-    for (auto& flag : flags) {
-      if (!flag.collected && SDL_HasIntersection(&player.rect, &flag.rect)) {
-        flag.collected = true;
-      }
+    // Check for collisions with the tiles under the player
+    int taken = grid.take(LAYER_FLAG, player.rect);
+    flagsLeft -= taken;
+    radarStale |= taken > 0;
+    if (flagsLeft == 0) {
+      SDL_Log("All flags collected!");
+      quit = true;
+    }
+
+    if (grid.any(LAYER_ROCK, player.rect)) {
+      // Crashed into a rock
+      quit = true;
     }
 
     for (auto& enemy : enemies) {
@@ -228,37 +860,76 @@ int main(int argc, char* argv[]) {
       }
     }
 
+    // Center the camera on the player, keeping it on the course
+    camera.x = std::max(0, std::min(player.rect.x + player.rect.w / 2 - SCREEN_WIDTH / 2, course.w - SCREEN_WIDTH));
+    camera.y = std::max(0, std::min(player.rect.y + player.rect.h / 2 - SCREEN_HEIGHT / 2, course.h - SCREEN_HEIGHT));
+
     // Clear screen
     SDL_SetRenderDrawColor(renderer, 0x00, 0x00, 0x00, 0xFF);
     SDL_RenderClear(renderer);
 
-    // Draw rocks
-    for (const auto& rock : rocks) {
-      SDL_RenderCopy(renderer, rockTexture, nullptr, &rock.rect);
+    // Draw walls in view
+    tileRects.clear();
+    grid.collect(LAYER_WALL, camera, tileRects);
+    SDL_SetRenderDrawColor(renderer, 0x20, 0x60, 0x20, 0xFF);
+    SDL_RenderFillRects(renderer, tileRects.data(), (int)tileRects.size());
+
+    // Draw rocks in view
+    tileRects.clear();
+    grid.collect(LAYER_ROCK, camera, tileRects);
+    for (const auto& rect : tileRects) {
+      SDL_RenderCopy(renderer, rockTexture, nullptr, &rect);
     }
 
-    // Draw flags
-    for (const auto& flag : flags) {
-      if (!flag.collected) {
-        SDL_RenderCopy(renderer, flagTexture, nullptr, &flag.rect);
-      }
+    // Draw flags in view
+    tileRects.clear();
+    grid.collect(LAYER_FLAG, camera, tileRects);
+    for (const auto& rect : tileRects) {
+      SDL_RenderCopy(renderer, flagTexture, nullptr, &rect);
     }
 
-    // Draw enemies
+    // Draw enemies in view
     for (const auto& enemy : enemies) {
-      if (enemy.active) {
-        SDL_RenderCopy(renderer, enemyTexture, nullptr, &enemy.rect);
+      if (enemy.active && SDL_HasIntersection(&enemy.rect, &camera)) {
+        // Stunned enemies spin on the spot
+        SDL_Rect rect = { enemy.rect.x - camera.x, enemy.rect.y - camera.y, enemy.rect.w, enemy.rect.h };
+        SDL_RenderCopyEx(renderer, enemyTexture, nullptr, &rect, enemy.stunned * 15.0, nullptr, SDL_FLIP_NONE);
       }
     }
 
     // Draw player
-    SDL_RenderCopy(renderer, carTexture, nullptr, &player.rect);
+    SDL_Rect playerRect = { player.rect.x - camera.x, player.rect.y - camera.y, player.rect.w, player.rect.h };
+    SDL_RenderCopy(renderer, carTexture, nullptr, &playerRect);
 
-    // Draw smoke
-    if (player.smoke) {
-      SDL_Rect smokeRect = { player.rect.x - TILE_SIZE / 2, player.rect.y - TILE_SIZE / 2, TILE_SIZE, TILE_SIZE };
-      SDL_RenderCopy(renderer, smokeTexture, nullptr, &smokeRect);
+    // Draw smoke in view as one batch
+    int smokeQuads = smoke.buildVertices(camera, smokeVertices.data());
+    if (smokeQuads > 0) {
+      SDL_RenderGeometry(renderer, smokeTexture, smokeVertices.data(), smokeQuads * 4, smoke.indices.data(), smokeQuads * 6);
+    }
+
+    // Draw radar: flags from the flag layer, then enemies and the player
+    if (radarStale) {
+      radarFlags.clear();
+      grid.collect(LAYER_FLAG, course, radarFlags);
+      for (auto& rect : radarFlags) {
+        rect = { radar.x + rect.x / TILE_SIZE * RADAR_SCALE, radar.y + rect.y / TILE_SIZE * RADAR_SCALE, RADAR_SCALE, RADAR_SCALE };
+      }
+      radarStale = false;
+    }
+    SDL_SetRenderDrawColor(renderer, 0x00, 0x00, 0x40, 0xFF);
+    SDL_RenderFillRect(renderer, &radar);
+    SDL_SetRenderDrawColor(renderer, 0xFF, 0xFF, 0x00, 0xFF);
+    SDL_RenderFillRects(renderer, radarFlags.data(), (int)radarFlags.size());
+    SDL_SetRenderDrawColor(renderer, 0xFF, 0x00, 0x00, 0xFF);
+    for (const auto& enemy : enemies) {
+      if (enemy.active) {
+        SDL_Rect dot = { radar.x + enemy.rect.x * RADAR_SCALE / TILE_SIZE, radar.y + enemy.rect.y * RADAR_SCALE / TILE_SIZE, RADAR_SCALE, RADAR_SCALE };
+        SDL_RenderFillRect(renderer, &dot);
+      }
     }
+    SDL_Rect playerDot = { radar.x + player.rect.x * RADAR_SCALE / TILE_SIZE, radar.y + player.rect.y * RADAR_SCALE / TILE_SIZE, RADAR_SCALE, RADAR_SCALE };
+    SDL_SetRenderDrawColor(renderer, 0xFF, 0xFF, 0xFF, 0xFF);
+    SDL_RenderFillRect(renderer, &playerDot);
 
     // Update screen
     SDL_RenderPresent(renderer);
@@ -1,35 +1,916 @@
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_image.h>
 #include <vector>
+#include <string>
+#include <algorithm>
+#include <cmath>
 #include <cstdlib> // For rand()
+#include <cstring>
 
 const int SCREEN_WIDTH = 800;
 const int SCREEN_HEIGHT = 600;
 const int LANE_WIDTH = 80;
-const int NUM_LANES = 6;
+const int NUM_LANES = 5; // Per direction, so both directions fit on screen
 const int ROAD_SPEED = 5; // Adjust for scrolling speed
 
+// Traffic settings. Traffic is kept on a stretch of road reaching past both
+// ends of the screen, from ROAD_START to ROAD_END relative to the camera.
+const int VEHICLE_WIDTH = 60;
+const int VEHICLE_HEIGHT = 80;
+const int VEHICLE_COUNT = 200;
+const int ROAD_LENGTH = SCREEN_HEIGHT * 10;
+const int ROAD_START = (SCREEN_HEIGHT - ROAD_LENGTH) / 2;
+const int ROAD_END = ROAD_START + ROAD_LENGTH;
+const int MIN_HEADWAY = 40; // Gap kept to the car ahead, in pixels
+
+// Highway settings. Enough segments to cover the screen plus one being
+// recycled; world y is shifted back by WORLD_REBASE whenever the player has
+// driven that far, so positions never overflow however long the drive.
+const int PLAYER_SCREEN_Y = SCREEN_HEIGHT - 100;
+const int SEGMENT_LENGTH = 120;
+const int SEGMENT_COUNT = SCREEN_HEIGHT / SEGMENT_LENGTH + 2;
+const int DASH_LENGTH = 60;
+const int WORLD_REBASE = 1 << 16;
+
+// Driver model settings, per tick: a simplified intelligent driver model in
+// which drivers speed up towards their desired speed and brake to keep a
+// safe time gap to the car ahead
+const float IDM_ACCELERATION = 0.05f;
+const float IDM_COMFORT_BRAKING = 0.15f;
+const float IDM_TIME_GAP = 15.0f;
+const float IDM_BRAKING_TERM = 0.5f / std::sqrt(IDM_ACCELERATION * IDM_COMFORT_BRAKING);
+const float IDM_FREE_ROAD = 1e6f; // Gap for a car with nothing ahead
+
+// Lane change settings. Drivers look at the neighbouring lanes every so
+// often and move over if they could accelerate noticeably harder there,
+// unless that would make the car behind them brake hard.
+const int LANE_CHANGE_INTERVAL = 30;
+const float LANE_CHANGE_GAIN = 0.02f;
+const float LANE_CHANGE_SAFE_BRAKING = 0.3f;
+const float LANE_SHIFT_DECAY = 0.85f; // Easing into the new lane per tick
+
+// Headless mode settings
+const int HEADLESS_VEHICLES = 10000;
+const int HEADLESS_TICKS = 3000;
+const int HEADLESS_PLAYER_SPEED = 12;
+
+// Livery settings. Car images are loaded as 8-bit indexed sprites and
+// repaints of the same car share one. Each sprite is baked once into an
+// atlas texture, and a livery is just the colour its paint is tinted, so
+// repaints cost no texture memory.
+const int REPAINTS_PER_CAR = 8;
+const int ATLAS_WIDTH = 128;
+const float REPAINT_MIN_SATURATION = 0.4f; // Paint rather than grey trim
+const float REPAINT_MIN_VALUE = 0.25f;
+const float PAINT_HUE_RANGE = 40.0f; // Degrees from the main paint colour
+const int OLD_CAR_TEXTURES = 5;      // player_car.png and car1.png to car4.png, one texture each
+
 // Define a structure for vehicles
 struct Vehicle {
-  SDL_Texture* texture;
+  int livery;
   SDL_Rect rect;
   int speed;
   bool goingSouth; // True if going south, false if going north
 };
 
-// Function to load a texture from an image file
-SDL_Texture* loadTexture(SDL_Renderer* renderer, const char* filename) {
-  SDL_Surface* surface = IMG_Load(filename);
-  if (!surface) {
+// Traffic in one lane as parallel arrays sorted by y, so the car ahead of
+// each car is its neighbour and a whole lane updates in simple loops.
+// Southbound lanes are on the left, northbound on the right.
+struct Lane {
+  bool goingSouth;
+  std::vector<float> y;            // World y of each car's top edge
+  std::vector<float> speed;        // Pixels per tick
+  std::vector<float> desiredSpeed;
+  std::vector<float> acceleration; // From the driver model this tick
+  std::vector<float> shift;        // Sideways offset left from a lane change
+  std::vector<int> timer;          // Ticks until the driver looks at changing lanes
+  std::vector<int> livery;
+
+  int size() const {
+    return (int)y.size();
+  }
+
+  void reserve(int count) {
+    y.reserve(count);
+    speed.reserve(count);
+    desiredSpeed.reserve(count);
+    acceleration.reserve(count);
+    shift.reserve(count);
+    timer.reserve(count);
+    livery.reserve(count);
+  }
+
+  // Adds a car at index, which must keep the lane sorted; vehicle.speed is
+  // the speed its driver wants
+  void insert(int index, float carY, float carSpeed, const Vehicle& vehicle) {
+    y.insert(y.begin() + index, carY);
+    speed.insert(speed.begin() + index, carSpeed);
+    desiredSpeed.insert(desiredSpeed.begin() + index, (float)vehicle.speed);
+    acceleration.insert(acceleration.begin() + index, 0.0f);
+    shift.insert(shift.begin() + index, 0.0f);
+    timer.insert(timer.begin() + index, LANE_CHANGE_INTERVAL);
+    livery.insert(livery.begin() + index, vehicle.livery);
+  }
+
+  // The car at index as a vehicle waiting to join the road
+  Vehicle vehicleAt(int index) const {
+    Vehicle vehicle;
+    vehicle.livery = livery[index];
+    vehicle.rect = {0, 0, VEHICLE_WIDTH, VEHICLE_HEIGHT};
+    vehicle.speed = (int)desiredSpeed[index];
+    vehicle.goingSouth = goingSouth;
+    return vehicle;
+  }
+
+  Vehicle remove(int index) {
+    Vehicle vehicle = vehicleAt(index);
+    y.erase(y.begin() + index);
+    speed.erase(speed.begin() + index);
+    desiredSpeed.erase(desiredSpeed.begin() + index);
+    acceleration.erase(acceleration.begin() + index);
+    shift.erase(shift.begin() + index);
+    timer.erase(timer.begin() + index);
+    livery.erase(livery.begin() + index);
+    return vehicle;
+  }
+
+  // Removes the first count cars
+  void removeFront(int count) {
+    y.erase(y.begin(), y.begin() + count);
+    speed.erase(speed.begin(), speed.begin() + count);
+    desiredSpeed.erase(desiredSpeed.begin(), desiredSpeed.begin() + count);
+    acceleration.erase(acceleration.begin(), acceleration.begin() + count);
+    shift.erase(shift.begin(), shift.begin() + count);
+    timer.erase(timer.begin(), timer.begin() + count);
+    livery.erase(livery.begin(), livery.begin() + count);
+  }
+};
+
+// All the traffic, kept on a stretch of road from roadStart to roadEnd
+// relative to the camera
+struct Traffic {
+  std::vector<Lane> lanes;
+  std::vector<Vehicle> joinAhead;  // Waiting to come in ahead of the player
+  std::vector<Vehicle> joinBehind; // Waiting to come in from behind
+  int roadStart;
+  int roadEnd;
+  long long laneChanges;
+};
+
+// A stretch of highway. Its look comes only from its number along the road,
+// so a stretch is the same every time it is generated.
+struct RoadSegment {
+  int y;            // World y of the top edge
+  long long number; // Counts up going north
+  Uint8 shade;      // Grey level of the asphalt
+  bool joint;       // Expansion joint across the top edge
+};
+
+// The highway on screen as a fixed ring of segments. Segments that scroll off
+// the bottom are regenerated as the next stretch ahead of the camera.
+struct Road {
+  RoadSegment segments[SEGMENT_COUNT];
+  int top; // Segment furthest ahead
+};
+
+// A car sprite as palette indices, with the colours of the first image that
+// used it and which of those colours are paint
+struct CarSprite {
+  SDL_Surface* indices; // SDL_PIXELFORMAT_INDEX8
+  std::vector<SDL_Color> colors;
+  std::vector<bool> paint;
+  int keyColor;         // Brightest paint colour, which a livery's tint replaces
+};
+
+// A car sprite and the colour its paint is tinted
+struct Livery {
+  int sprite;
+  SDL_Color tint;
+};
+
+// Car sprites and their liveries, used while loading
+struct CarSprites {
+  std::vector<CarSprite> sprites;
+  std::vector<Livery> liveries;
+};
+
+// Every car sprite baked into one texture as a body and a paint mask. A
+// livery is drawn as the body with the mask tinted over it, so any number of
+// liveries fit in the memory of the sprites.
+struct CarAtlas {
+  SDL_Texture* texture = nullptr;
+  std::vector<SDL_Rect> bodyCells;  // Per sprite: trim, glass and tyres, with the paint clear
+  std::vector<SDL_Rect> paintCells; // Per sprite: the paint, to be tinted
+  std::vector<Livery> liveries;
+  int width = 0;
+  int height = 0;
+};
+
+// Function to find the first car in a lane at or below y, by binary search
+int findCar(const Lane& lane, float y) {
+  return (int)(std::lower_bound(lane.y.begin(), lane.y.end(), y) - lane.y.begin());
+}
+
+// Function to get a driver's acceleration from the driver model, given the
+// gap to the car ahead (bumper to bumper) and how fast it is closing
+inline float idmAcceleration(float speed, float desiredSpeed, float gap, float closing) {
+  float ratio = speed / desiredSpeed;
+  ratio *= ratio;
+  // Plain selects rather than std::max so whole-lane loops stay branch free
+  float dynamic = speed * IDM_TIME_GAP + speed * closing * IDM_BRAKING_TERM;
+  float wanted = MIN_HEADWAY + (dynamic > 0.0f ? dynamic : 0.0f);
+  float pressure = wanted / (gap > 1.0f ? gap : 1.0f);
+  return IDM_ACCELERATION * (1.0f - ratio * ratio - pressure * pressure);
+}
+
+// Function to check whether two indexed sprites have the same pixels
+bool sameIndices(const SDL_Surface* a, const SDL_Surface* b) {
+  if (a->w != b->w || a->h != b->h) {
+    return false;
+  }
+  for (int y = 0; y < a->h; ++y) {
+    if (memcmp((const Uint8*)a->pixels + y * a->pitch, (const Uint8*)b->pixels + y * b->pitch, a->w) != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Function to check whether two colours are the same
+bool sameColor(SDL_Color a, SDL_Color b) {
+  return a.r == b.r && a.g == b.g && a.b == b.b && a.a == b.a;
+}
+
+// Function to get the hue of a paint colour in degrees. Returns false for
+// greys and dark colours, such as glass, tyres and trim.
+bool paintHue(SDL_Color color, float& hue) {
+  float r = color.r / 255.0f;
+  float g = color.g / 255.0f;
+  float b = color.b / 255.0f;
+  float value = std::max(r, std::max(g, b));
+  float chroma = value - std::min(r, std::min(g, b));
+  if (value < REPAINT_MIN_VALUE || chroma < REPAINT_MIN_SATURATION * value) {
+    return false;
+  }
+  if (value == r) {
+    hue = 60.0f * std::fmod((g - b) / chroma + 6.0f, 6.0f);
+  } else if (value == g) {
+    hue = 60.0f * ((b - r) / chroma + 2.0f);
+  } else {
+    hue = 60.0f * ((r - g) / chroma + 4.0f);
+  }
+  return true;
+}
+
+// Function to turn the hue of a paint colour, leaving greys alone
+SDL_Color turnHue(SDL_Color color, float degrees) {
+  float hue;
+  if (!paintHue(color, hue)) {
+    return color;
+  }
+  hue = std::fmod(hue + degrees, 360.0f);
+
+  float value = std::max(color.r, std::max(color.g, color.b)) / 255.0f;
+  float chroma = value - std::min(color.r, std::min(color.g, color.b)) / 255.0f;
+  float side = chroma * (1.0f - std::fabs(std::fmod(hue / 60.0f, 2.0f) - 1.0f));
+  float rgb[3];
+  switch ((int)(hue / 60.0f)) {
+    case 0: rgb[0] = chroma; rgb[1] = side; rgb[2] = 0.0f; break;
+    case 1: rgb[0] = side; rgb[1] = chroma; rgb[2] = 0.0f; break;
+    case 2: rgb[0] = 0.0f; rgb[1] = chroma; rgb[2] = side; break;
+    case 3: rgb[0] = 0.0f; rgb[1] = side; rgb[2] = chroma; break;
+    case 4: rgb[0] = side; rgb[1] = 0.0f; rgb[2] = chroma; break;
+    default: rgb[0] = chroma; rgb[1] = 0.0f; rgb[2] = side; break;
+  }
+  float base = value - chroma;
+  SDL_Color turned = {(Uint8)((rgb[0] + base) * 255.0f + 0.5f), (Uint8)((rgb[1] + base) * 255.0f + 0.5f),
+                      (Uint8)((rgb[2] + base) * 255.0f + 0.5f), color.a};
+  return turned;
+}
+
+// Function to get how bright a colour is, as the sum of its channels
+int brightness(SDL_Color color) {
+  return color.r + color.g + color.b;
+}
+
+// Function to find which colours of a new sprite are paint: the most used
+// paint colour and those close to it in hue. Other bright colours, such as
+// lamps and stripes, stay as they are in every livery.
+void findPaint(CarSprite& sprite, const std::vector<int>& counts) {
+  int dominant = -1;
+  float dominantHue = 0.0f;
+  for (int i = 0; i < (int)sprite.colors.size(); ++i) {
+    float hue;
+    if (paintHue(sprite.colors[i], hue) && (dominant < 0 || counts[i] > counts[dominant])) {
+      dominant = i;
+      dominantHue = hue;
+    }
+  }
+  sprite.paint.assign(sprite.colors.size(), false);
+  sprite.keyColor = -1;
+  for (int i = 0; i < (int)sprite.colors.size(); ++i) {
+    float hue;
+    if (dominant >= 0 && paintHue(sprite.colors[i], hue)) {
+      float apart = std::fabs(hue - dominantHue);
+      sprite.paint[i] = std::min(apart, 360.0f - apart) <= PAINT_HUE_RANGE;
+      if (sprite.paint[i] && (sprite.keyColor < 0 || brightness(sprite.colors[i]) > brightness(sprite.colors[sprite.keyColor]))) {
+        sprite.keyColor = i;
+      }
+    }
+  }
+}
+
+// Function to load a car image as an indexed sprite plus a livery, returning
+// the livery or -1. Colours are numbered in the order they first appear, so
+// an image that only repaints an earlier one (same pixels, same trim) shares
+// its sprite, and its livery is just the colour of its paint.
+int loadCarLivery(CarSprites& cars, const char* filename) {
+  SDL_Surface* loaded = IMG_Load(filename);
+  if (!loaded) {
     SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Couldn't load image: %s", IMG_GetError());
-    return nullptr;
+    return -1;
+  }
+  SDL_Surface* surface = SDL_ConvertSurfaceFormat(loaded, SDL_PIXELFORMAT_ARGB8888, 0);
+  SDL_FreeSurface(loaded);
+  if (!surface) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Couldn't convert %s: %s", filename, SDL_GetError());
+    return -1;
+  }
+  SDL_Surface* indexed = SDL_CreateRGBSurfaceWithFormat(0, surface->w, surface->h, 8, SDL_PIXELFORMAT_INDEX8);
+  if (!indexed) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Couldn't create indexed sprite: %s", SDL_GetError());
+    SDL_FreeSurface(surface);
+    return -1;
+  }
+
+  std::vector<Uint32> palette;
+  std::vector<SDL_Color> colors;
+  std::vector<int> counts;
+  for (int y = 0; y < surface->h; ++y) {
+    const Uint32* row = (const Uint32*)((const Uint8*)surface->pixels + y * surface->pitch);
+    Uint8* indices = (Uint8*)indexed->pixels + y * indexed->pitch;
+    for (int x = 0; x < surface->w; ++x) {
+      size_t index = std::find(palette.begin(), palette.end(), row[x]) - palette.begin();
+      if (index == palette.size()) {
+        if (palette.size() == 256) {
+          SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "%s has more than 256 colours", filename);
+          SDL_FreeSurface(indexed);
+          SDL_FreeSurface(surface);
+          return -1;
+        }
+        SDL_Color color;
+        SDL_GetRGBA(row[x], surface->format, &color.r, &color.g, &color.b, &color.a);
+        palette.push_back(row[x]);
+        colors.push_back(color);
+        counts.push_back(0);
+      }
+      indices[x] = (Uint8)index;
+      counts[index]++;
+    }
+  }
+  SDL_FreeSurface(surface);
+
+  // Share an earlier sprite if only the paint differs
+  Livery livery;
+  livery.sprite = -1;
+  for (int i = 0; i < (int)cars.sprites.size() && livery.sprite < 0; ++i) {
+    const CarSprite& sprite = cars.sprites[i];
+    bool same = sprite.colors.size() == colors.size() && sameIndices(sprite.indices, indexed);
+    for (int c = 0; same && c < (int)colors.size(); ++c) {
+      same = sprite.paint[c] || sameColor(sprite.colors[c], colors[c]);
+    }
+    if (same) {
+      livery.sprite = i;
+    }
+  }
+  if (livery.sprite >= 0) {
+    SDL_FreeSurface(indexed);
+  } else {
+    CarSprite sprite;
+    sprite.indices = indexed;
+    sprite.colors = colors;
+    findPaint(sprite, counts);
+    livery.sprite = (int)cars.sprites.size();
+    cars.sprites.push_back(sprite);
+  }
+  const CarSprite& sprite = cars.sprites[livery.sprite];
+  livery.tint = sprite.keyColor >= 0 ? colors[sprite.keyColor] : SDL_Color{0xFF, 0xFF, 0xFF, 0xFF};
+
+  for (int i = 0; i < (int)cars.liveries.size(); ++i) {
+    if (cars.liveries[i].sprite == livery.sprite && sameColor(cars.liveries[i].tint, livery.tint)) {
+      return i;
+    }
+  }
+  cars.liveries.push_back(livery);
+  return (int)cars.liveries.size() - 1;
+}
+
+// Function to add repaints of a livery with the hue of its paint turned
+// evenly around the colour wheel, adding the new liveries to a list
+void addRepaints(CarSprites& cars, int livery, int count, std::vector<int>& liveries) {
+  for (int i = 1; i <= count; ++i) {
+    Livery repaint = cars.liveries[livery];
+    repaint.tint = turnHue(repaint.tint, 360.0f * i / (count + 1));
+    cars.liveries.push_back(repaint);
+    liveries.push_back((int)cars.liveries.size() - 1);
+  }
+}
+
+// Function to bake each sprite into one atlas texture as a body and a paint
+// mask, packed in rows, tallest first. The mask holds each paint colour as a
+// grey shade of the sprite's key colour, so tinting it with a livery's tint
+// gives that colour back, with darker shades for the rest of the paint. The
+// indexed sprites are freed afterwards.
+bool bakeCarAtlas(SDL_Renderer* renderer, CarSprites& cars, CarAtlas& atlas) {
+  int count = (int)cars.sprites.size();
+  std::vector<int> order(count);
+  for (int i = 0; i < count; ++i) {
+    order[i] = i;
+  }
+  std::stable_sort(order.begin(), order.end(), [&cars](int a, int b) {
+    return cars.sprites[a].indices->h > cars.sprites[b].indices->h;
+  });
+
+  // Widen the atlas for any car wider than a row, so every cell fits inside it
+  atlas.width = ATLAS_WIDTH;
+  for (const CarSprite& sprite : cars.sprites) {
+    atlas.width = std::max(atlas.width, sprite.indices->w);
+  }
+
+  atlas.bodyCells.resize(count);
+  atlas.paintCells.resize(count);
+  int x = 0;
+  int y = 0;
+  int rowHeight = 0;
+  for (int cell = 0; cell < count * 2; ++cell) {
+    int index = order[cell / 2];
+    const SDL_Surface* sprite = cars.sprites[index].indices;
+    if (x + sprite->w > atlas.width) {
+      x = 0;
+      y += rowHeight;
+      rowHeight = 0;
+    }
+    SDL_Rect& rect = cell % 2 == 0 ? atlas.bodyCells[index] : atlas.paintCells[index];
+    rect = {x, y, sprite->w, sprite->h};
+    x += sprite->w;
+    rowHeight = std::max(rowHeight, sprite->h);
+  }
+
+  atlas.height = std::max(y + rowHeight, 1);
+  SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, atlas.width, atlas.height, 32, SDL_PIXELFORMAT_ARGB8888);
+  if (!surface) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Couldn't create car atlas: %s", SDL_GetError());
+    return false;
+  }
+  SDL_FillRect(surface, nullptr, 0);
+  for (int i = 0; i < count; ++i) {
+    const CarSprite& sprite = cars.sprites[i];
+    std::vector<Uint32> body(sprite.colors.size(), 0);
+    std::vector<Uint32> paint(sprite.colors.size(), 0);
+    for (int c = 0; c < (int)sprite.colors.size(); ++c) {
+      SDL_Color color = sprite.colors[c];
+      if (!sprite.paint[c]) {
+        body[c] = SDL_MapRGBA(surface->format, color.r, color.g, color.b, color.a);
+      } else {
+        Uint8 shade = (Uint8)std::min(brightness(color) * 255 / std::max(brightness(sprite.colors[sprite.keyColor]), 1), 255);
+        paint[c] = SDL_MapRGBA(surface->format, shade, shade, shade, color.a);
+      }
+    }
+    const SDL_Rect& bodyCell = atlas.bodyCells[i];
+    const SDL_Rect& paintCell = atlas.paintCells[i];
+    for (int row = 0; row < sprite.indices->h; ++row) {
+      const Uint8* indices = (const Uint8*)sprite.indices->pixels + row * sprite.indices->pitch;
+      Uint32* bodyRow = (Uint32*)((Uint8*)surface->pixels + (bodyCell.y + row) * surface->pitch) + bodyCell.x;
+      Uint32* paintRow = (Uint32*)((Uint8*)surface->pixels + (paintCell.y + row) * surface->pitch) + paintCell.x;
+      for (int column = 0; column < sprite.indices->w; ++column) {
+        bodyRow[column] = body[indices[column]];
+        paintRow[column] = paint[indices[column]];
+      }
+    }
   }
-  SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
+  atlas.texture = SDL_CreateTextureFromSurface(renderer, surface);
   SDL_FreeSurface(surface);
-  return texture;
+  if (!atlas.texture) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Couldn't create car atlas texture: %s", SDL_GetError());
+    return false;
+  }
+  SDL_SetTextureBlendMode(atlas.texture, SDL_BLENDMODE_BLEND);
+
+  for (auto& sprite : cars.sprites) {
+    SDL_FreeSurface(sprite.indices);
+  }
+  cars.sprites.clear();
+  atlas.liveries = cars.liveries;
+  return true;
+}
+
+// Function to draw a car in a livery: the body, then the paint tinted over it
+void drawCar(SDL_Renderer* renderer, const CarAtlas& atlas, int livery, const SDL_Rect& rect) {
+  const Livery& car = atlas.liveries[livery];
+  SDL_SetTextureColorMod(atlas.texture, 0xFF, 0xFF, 0xFF);
+  SDL_RenderCopy(renderer, atlas.texture, &atlas.bodyCells[car.sprite], &rect);
+  SDL_SetTextureColorMod(atlas.texture, car.tint.r, car.tint.g, car.tint.b);
+  SDL_RenderCopy(renderer, atlas.texture, &atlas.paintCells[car.sprite], &rect);
+}
+
+// Function to get the x position of a car driving in a lane
+int laneX(int lane) {
+  return LANE_WIDTH * lane + (LANE_WIDTH - VEHICLE_WIDTH) / 2;
+}
+
+// Function to give a segment the look of a numbered stretch of road
+void generateSegment(RoadSegment& segment, long long number) {
+  Uint64 hash = (Uint64)number * 0x9E3779B97F4A7C15ull;
+  segment.number = number;
+  segment.shade = 0x38 + (Uint8)(hash >> 60);
+  segment.joint = number % 10 == 0;
+}
+
+// Function to lay the ring of segments up the screen from its bottom edge
+void initRoad(Road& road, int cameraY) {
+  for (int i = 0; i < SEGMENT_COUNT; ++i) {
+    generateSegment(road.segments[i], i);
+    road.segments[i].y = cameraY + SCREEN_HEIGHT - (i + 1) * SEGMENT_LENGTH;
+  }
+  road.top = SEGMENT_COUNT - 1;
+}
+
+// Function to recycle segments that have scrolled off the bottom of the
+// screen into the stretch ahead of the top one
+void updateRoad(Road& road, int cameraY) {
+  int bottom = (road.top + 1) % SEGMENT_COUNT;
+  while (road.segments[bottom].y >= cameraY + SCREEN_HEIGHT) {
+    const RoadSegment& ahead = road.segments[road.top];
+    RoadSegment& segment = road.segments[bottom];
+    generateSegment(segment, ahead.number + 1);
+    segment.y = ahead.y - SEGMENT_LENGTH;
+    road.top = bottom;
+    bottom = (bottom + 1) % SEGMENT_COUNT;
+  }
+}
+
+// Function to draw the segments on screen: asphalt, dashed lane lines, a
+// solid double line down the middle and any joints
+void drawRoad(SDL_Renderer* renderer, const Road& road, int cameraY) {
+  SDL_Rect dashes[NUM_LANES * 2];
+  for (const RoadSegment& segment : road.segments) {
+    int y = segment.y - cameraY;
+    SDL_Rect asphalt = {0, y, SCREEN_WIDTH, SEGMENT_LENGTH};
+    SDL_SetRenderDrawColor(renderer, segment.shade, segment.shade, segment.shade, 0xFF);
+    SDL_RenderFillRect(renderer, &asphalt);
+
+    int count = 0;
+    for (int i = 1; i < NUM_LANES * 2; ++i) {
+      if (i != NUM_LANES) {
+        dashes[count++] = {LANE_WIDTH * i - 2, y, 4, DASH_LENGTH};
+      }
+    }
+    SDL_SetRenderDrawColor(renderer, 0xFF, 0xFF, 0xFF, 0xFF);
+    SDL_RenderFillRects(renderer, dashes, count);
+
+    SDL_Rect middle[] = {{LANE_WIDTH * NUM_LANES - 6, y, 3, SEGMENT_LENGTH}, {LANE_WIDTH * NUM_LANES + 3, y, 3, SEGMENT_LENGTH}};
+    SDL_SetRenderDrawColor(renderer, 0xFF, 0xCC, 0x00, 0xFF);
+    SDL_RenderFillRects(renderer, middle, 2);
+
+    if (segment.joint) {
+      SDL_Rect joint = {0, y, SCREEN_WIDTH, 3};
+      SDL_SetRenderDrawColor(renderer, 0x20, 0x20, 0x20, 0xFF);
+      SDL_RenderFillRect(renderer, &joint);
+    }
+  }
+}
+
+// Function to bring waiting cars onto the road at its top or bottom end, in
+// a random lane for their direction that has room for the minimum headway.
+// Cars that find no room stay waiting.
+void joinTraffic(std::vector<Lane>& lanes, std::vector<Vehicle>& waiting, bool atTop, float top, float bottom) {
+  size_t kept = 0;
+  for (size_t w = 0; w < waiting.size(); ++w) {
+    const Vehicle& vehicle = waiting[w];
+    int first = vehicle.goingSouth ? 0 : NUM_LANES;
+    int offset = rand() % NUM_LANES;
+    bool joined = false;
+    for (int i = 0; i < NUM_LANES && !joined; ++i) {
+      Lane& lane = lanes[first + (offset + i) % NUM_LANES];
+      if (atTop) {
+        if (lane.size() == 0 || lane.y.front() - (top + VEHICLE_HEIGHT) >= MIN_HEADWAY) {
+          lane.insert(0, top, (float)vehicle.speed, vehicle);
+          joined = true;
+        }
+      } else {
+        float y = bottom - VEHICLE_HEIGHT;
+        if (lane.size() == 0 || y - (lane.y.back() + VEHICLE_HEIGHT) >= MIN_HEADWAY) {
+          lane.insert(lane.size(), y, (float)vehicle.speed, vehicle);
+          joined = true;
+        }
+      }
+    }
+    if (!joined) {
+      waiting[kept++] = waiting[w];
+    }
+  }
+  waiting.resize(kept);
+}
+
+// Function to run the driver model over a lane in whole-lane passes: gaps
+// and accelerations from last tick's positions, then speeds and positions.
+// A last pass holds each car off the one ahead in case of hard braking, which
+// keeps the lane sorted.
+void driveLane(Lane& lane) {
+  int count = lane.size();
+  if (count == 0) {
+    return;
+  }
+  float* y = lane.y.data();
+  float* speed = lane.speed.data();
+  const float* desired = lane.desiredSpeed.data();
+  float* acceleration = lane.acceleration.data();
+
+  // Southbound cars follow the next car down the array, northbound the one before
+  if (lane.goingSouth) {
+    for (int i = 0; i < count - 1; ++i) {
+      acceleration[i] = idmAcceleration(speed[i], desired[i], y[i + 1] - y[i] - VEHICLE_HEIGHT, speed[i] - speed[i + 1]);
+    }
+    acceleration[count - 1] = idmAcceleration(speed[count - 1], desired[count - 1], IDM_FREE_ROAD, 0.0f);
+  } else {
+    acceleration[0] = idmAcceleration(speed[0], desired[0], IDM_FREE_ROAD, 0.0f);
+    for (int i = 1; i < count; ++i) {
+      acceleration[i] = idmAcceleration(speed[i], desired[i], y[i] - y[i - 1] - VEHICLE_HEIGHT, speed[i] - speed[i - 1]);
+    }
+  }
+
+  const float direction = lane.goingSouth ? 1.0f : -1.0f;
+  float* shift = lane.shift.data();
+  int* timer = lane.timer.data();
+  for (int i = 0; i < count; ++i) {
+    float newSpeed = speed[i] + acceleration[i];
+    newSpeed = newSpeed > 0.0f ? newSpeed : 0.0f;
+    speed[i] = newSpeed;
+    y[i] += direction * newSpeed;
+    // Snapped to zero under half a pixel so it never decays into denormals
+    float newShift = shift[i] * LANE_SHIFT_DECAY;
+    shift[i] = std::fabs(newShift) < 0.5f ? 0.0f : newShift;
+    timer[i] -= 1;
+  }
+
+  if (lane.goingSouth) {
+    for (int i = count - 2; i >= 0; --i) {
+      y[i] = std::min(y[i], y[i + 1] - VEHICLE_HEIGHT);
+    }
+  } else {
+    for (int i = 1; i < count; ++i) {
+      y[i] = std::max(y[i], y[i - 1] + VEHICLE_HEIGHT);
+    }
+  }
+}
+
+// Function to score moving a car into another lane: how much harder it could
+// accelerate there behind its new leader. Returns a large negative number if
+// either gap is under the minimum or the new follower would have to brake
+// harder than is safe.
+float laneChangeGain(const Lane& target, float y, float speed, float desired, float acceleration) {
+  const float rejected = -1e9f;
+  int below = findCar(target, y);
+  int leader = target.goingSouth ? below : below - 1;
+  int follower = target.goingSouth ? below - 1 : below;
+  float gap = IDM_FREE_ROAD;
+  float closing = 0.0f;
+  if (leader >= 0 && leader < target.size()) {
+    gap = std::fabs(target.y[leader] - y) - VEHICLE_HEIGHT;
+    closing = speed - target.speed[leader];
+    if (gap < MIN_HEADWAY) {
+      return rejected;
+    }
+  }
+  if (follower >= 0 && follower < target.size()) {
+    float behind = std::fabs(y - target.y[follower]) - VEHICLE_HEIGHT;
+    float followerSpeed = target.speed[follower];
+    if (behind < MIN_HEADWAY ||
+        idmAcceleration(followerSpeed, target.desiredSpeed[follower], behind, followerSpeed - speed) < -LANE_CHANGE_SAFE_BRAKING) {
+      return rejected;
+    }
+  }
+  return idmAcceleration(speed, desired, gap, closing) - acceleration;
+}
+
+// Function to let drivers whose timer has run out move to a neighbouring lane
+// in their direction when the gain is worth it, returning how many did
+int changeLanes(std::vector<Lane>& lanes) {
+  int changes = 0;
+  for (int index = 0; index < (int)lanes.size(); ++index) {
+    Lane& lane = lanes[index];
+    int first = lane.goingSouth ? 0 : NUM_LANES;
+    for (int i = 0; i < lane.size(); ++i) {
+      if (lane.timer[i] > 0) {
+        continue;
+      }
+      lane.timer[i] = LANE_CHANGE_INTERVAL;
+      // No lane beats an empty road, so drivers already close to that stay put
+      float freeRoad = idmAcceleration(lane.speed[i], lane.desiredSpeed[i], IDM_FREE_ROAD, 0.0f);
+      if (freeRoad - lane.acceleration[i] <= LANE_CHANGE_GAIN) {
+        continue;
+      }
+
+      int best = -1;
+      float bestGain = LANE_CHANGE_GAIN;
+      for (int side = -1; side <= 1; side += 2) {
+        int target = index + side;
+        if (target < first || target >= first + NUM_LANES) {
+          continue;
+        }
+        float gain = laneChangeGain(lanes[target], lane.y[i], lane.speed[i], lane.desiredSpeed[i], lane.acceleration[i]);
+        if (gain > bestGain) {
+          best = target;
+          bestGain = gain;
+        }
+      }
+      if (best >= 0) {
+        // Ease over from the old lane rather than jumping
+        float y = lane.y[i];
+        float speed = lane.speed[i];
+        float shift = lane.shift[i] + (index - best) * LANE_WIDTH;
+        Vehicle vehicle = lane.remove(i);
+        Lane& target = lanes[best];
+        int at = findCar(target, y);
+        target.insert(at, y, speed, vehicle);
+        target.shift[at] = shift;
+        ++changes;
+        --i;
+      }
+    }
+  }
+  return changes;
+}
+
+// Function to advance all traffic one tick on the stretch of road around the
+// camera. Cars the player leaves behind come back in ahead, and cars that
+// pull away ahead come back in from behind.
+void updateTraffic(Traffic& traffic, int cameraY) {
+  float top = (float)(cameraY + traffic.roadStart);
+  float bottom = (float)(cameraY + traffic.roadEnd);
+  for (auto& lane : traffic.lanes) {
+    driveLane(lane);
+  }
+  traffic.laneChanges += changeLanes(traffic.lanes);
+  for (auto& lane : traffic.lanes) {
+    while (lane.size() > 0 && lane.y.back() >= bottom) {
+      traffic.joinAhead.push_back(lane.remove(lane.size() - 1));
+    }
+    int gone = 0;
+    while (gone < lane.size() && lane.y[gone] + VEHICLE_HEIGHT <= top) {
+      traffic.joinBehind.push_back(lane.vehicleAt(gone++));
+    }
+    lane.removeFront(gone);
+  }
+  joinTraffic(traffic.lanes, traffic.joinAhead, true, top, bottom);
+  joinTraffic(traffic.lanes, traffic.joinBehind, false, top, bottom);
+}
+
+// Function to create traffic spread over random free slots on a stretch of
+// road long enough to leave room between cars. Any that do not fit wait to
+// join ahead of the player. Every array is sized for all the traffic up
+// front so driving never allocates.
+void initTraffic(Traffic& traffic, int vehicleCount, const std::vector<int>& liveries, int cameraY) {
+  int roadLength = std::max(ROAD_LENGTH, vehicleCount * (VEHICLE_HEIGHT + MIN_HEADWAY) / NUM_LANES);
+  traffic.roadStart = (SCREEN_HEIGHT - roadLength) / 2;
+  traffic.roadEnd = traffic.roadStart + roadLength;
+  traffic.laneChanges = 0;
+  traffic.lanes.assign(NUM_LANES * 2, Lane());
+  traffic.joinAhead.clear();
+  traffic.joinBehind.clear();
+  traffic.joinAhead.reserve(vehicleCount);
+  traffic.joinBehind.reserve(vehicleCount);
+
+  std::vector<int> slots;
+  const int slotsPerLane = roadLength / (VEHICLE_HEIGHT + MIN_HEADWAY);
+  for (int lane = 0; lane < NUM_LANES * 2; ++lane) {
+    traffic.lanes[lane].goingSouth = lane < NUM_LANES;
+    traffic.lanes[lane].reserve(vehicleCount);
+    for (int slot = 0; slot < slotsPerLane; ++slot) {
+      slots.push_back(lane * slotsPerLane + slot);
+    }
+  }
+  for (int i = (int)slots.size() - 1; i > 0; --i) {
+    std::swap(slots[i], slots[rand() % (i + 1)]);
+  }
+  std::sort(slots.begin(), slots.begin() + std::min(vehicleCount, (int)slots.size()));
+
+  for (int i = 0; i < vehicleCount; ++i) {
+    Vehicle vehicle;
+    vehicle.livery = liveries[i % liveries.size()];
+    vehicle.speed = ROAD_SPEED + rand() % 5; 
+    vehicle.rect = {0, 0, VEHICLE_WIDTH, VEHICLE_HEIGHT};
+    if (i < (int)slots.size()) {
+      // Direction follows the lane (south on the left, north on the right).
+      // Slots are sorted, so each lane fills in order of y.
+      Lane& lane = traffic.lanes[slots[i] / slotsPerLane];
+      vehicle.goingSouth = lane.goingSouth;
+      float y = (float)(cameraY + traffic.roadStart + slots[i] % slotsPerLane * (VEHICLE_HEIGHT + MIN_HEADWAY));
+      lane.insert(lane.size(), y, (float)vehicle.speed, vehicle);
+      lane.timer.back() = rand() % LANE_CHANGE_INTERVAL;
+    } else {
+      vehicle.goingSouth = i % 2 == 0;
+      traffic.joinAhead.push_back(vehicle);
+    }
+  }
+}
+
+// Function to shift all traffic along the road when the world is rebased
+void rebaseTraffic(Traffic& traffic, int offset) {
+  for (auto& lane : traffic.lanes) {
+    for (auto& y : lane.y) {
+      y += offset;
+    }
+  }
+}
+
+// Function to check for a car overlapping a rectangle. Only the lanes under
+// the rectangle and their neighbours are searched, each by binary search on
+// y: a car changing lanes is already stored in its new lane while its shift
+// still draws it over the old one. Lane changes never cross the middle of
+// the road, so the neighbours of a lane hold every car that can be drawn
+// over it.
+bool findCollision(const Traffic& traffic, const SDL_Rect& rect) {
+  int first = std::max(rect.x / LANE_WIDTH - 1, 0);
+  int last = std::min((rect.x + rect.w - 1) / LANE_WIDTH + 1, (int)traffic.lanes.size() - 1);
+  for (int index = first; index <= last; ++index) {
+    const Lane& lane = traffic.lanes[index];
+    for (int i = findCar(lane, (float)(rect.y - VEHICLE_HEIGHT + 1)); i < lane.size() && lane.y[i] < rect.y + rect.h; ++i) {
+      SDL_Rect car = {laneX(index) + (int)lane.shift[i], (int)lane.y[i], VEHICLE_WIDTH, VEHICLE_HEIGHT};
+      if (SDL_HasIntersection(&rect, &car)) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+// Function to draw the cars on screen, found by binary search in each lane
+void drawTraffic(SDL_Renderer* renderer, const Traffic& traffic, const CarAtlas& atlas, int cameraY) {
+  for (int index = 0; index < (int)traffic.lanes.size(); ++index) {
+    const Lane& lane = traffic.lanes[index];
+    for (int i = findCar(lane, (float)(cameraY + 1 - VEHICLE_HEIGHT)); i < lane.size() && lane.y[i] < cameraY + SCREEN_HEIGHT; ++i) {
+      SDL_Rect rect = {laneX(index) + (int)lane.shift[i], (int)lane.y[i] - cameraY, VEHICLE_WIDTH, VEHICLE_HEIGHT};
+      drawCar(renderer, atlas, lane.livery[i], rect);
+    }
+  }
+}
+
+// Function to time the traffic on its own, with the player driving at a
+// steady speed, and print ticks per second
+int runHeadless(int vehicleCount, int ticks) {
+  std::vector<int> liveries(1, 0);
+  int playerY = PLAYER_SCREEN_Y;
+  Traffic traffic;
+  initTraffic(traffic, vehicleCount, liveries, playerY - PLAYER_SCREEN_Y);
+
+  Uint64 total = 0;
+  Uint64 worst = 0;
+  for (int tick = 0; tick < ticks; ++tick) {
+    playerY -= HEADLESS_PLAYER_SPEED;
+    if (playerY < -WORLD_REBASE) {
+      playerY += WORLD_REBASE;
+      rebaseTraffic(traffic, WORLD_REBASE);
+    }
+    Uint64 start = SDL_GetPerformanceCounter();
+    updateTraffic(traffic, playerY - PLAYER_SCREEN_Y);
+    Uint64 elapsed = SDL_GetPerformanceCounter() - start;
+    total += elapsed;
+    worst = std::max(worst, elapsed);
+  }
+
+  double frequency = (double)SDL_GetPerformanceFrequency();
+  int onRoad = 0;
+  for (const auto& lane : traffic.lanes) {
+    onRoad += lane.size();
+  }
+  SDL_Log("%d cars (%d on the road), %d ticks: %.3f ms per tick, worst %.3f ms, %.0f ticks/s, %lld lane changes",
+          vehicleCount, onRoad, ticks, total * 1000.0 / frequency / ticks, worst * 1000.0 / frequency,
+          ticks * frequency / total, traffic.laneChanges);
+  return 0;
 }
 
 int main(int argc, char* argv[]) {
+  int vehicleCount = -1;
+  int headlessTicks = 0;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--vehicles" && i + 1 < argc) {
+      vehicleCount = std::max(atoi(argv[++i]), 0);
+    } else if (arg == "--headless") {
+      headlessTicks = HEADLESS_TICKS;
+      if (i + 1 < argc && atoi(argv[i + 1]) > 0) {
+        headlessTicks = atoi(argv[++i]);
+      }
+    }
+  }
+  if (headlessTicks > 0) {
+    return runHeadless(vehicleCount < 0 ? HEADLESS_VEHICLES : vehicleCount, headlessTicks);
+  }
+  if (vehicleCount < 0) {
+    vehicleCount = VEHICLE_COUNT;
+  }
+
   // Initialize SDL
   if (SDL_Init(SDL_INIT_VIDEO) < 0) {
     SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Couldn't initialize SDL: %s", SDL_GetError());
@@ -49,47 +930,58 @@ int main(int argc, char* argv[]) {
     return 1;
   }
 
-  // Load vehicle textures (replace with your image files)
-  SDL_Texture* playerTexture = loadTexture(renderer, "player_car.png");
-  SDL_Texture* car1Texture = loadTexture(renderer, "car1.png");
-  SDL_Texture* car2Texture = loadTexture(renderer, "car2.png");
-  SDL_Texture* car3Texture = loadTexture(renderer, "car3.png"); 
-  SDL_Texture* car4Texture = loadTexture(renderer, "car4.png"); 
-  // ... load other car textures (car5.png, car6.png, etc.)
+  // Load the cars, give each traffic car some repaints and bake them all
+  // into one texture
+  const char* carFiles[] = {"car1.png", "car2.png", "car3.png", "car4.png", "car11.png", "car3_0.png", "car3_2.png"};
+  CarSprites cars;
+  int playerLivery = loadCarLivery(cars, "player_car.png");
+  std::vector<int> fileLiveries(1, playerLivery);
+  std::vector<int> trafficLiveries;
+  for (const char* file : carFiles) {
+    int livery = loadCarLivery(cars, file);
+    fileLiveries.push_back(livery);
+    if (livery >= 0 && livery != playerLivery &&
+        std::find(trafficLiveries.begin(), trafficLiveries.end(), livery) == trafficLiveries.end()) {
+      trafficLiveries.push_back(livery);
+    }
+  }
+  for (int i = 0, count = (int)trafficLiveries.size(); i < count; ++i) {
+    addRepaints(cars, trafficLiveries[i], REPAINTS_PER_CAR, trafficLiveries);
+  }
+
+  // What the cars used to take as one texture per image, against the atlas
+  int oldBytes = 0;
+  for (int i = 0; i < OLD_CAR_TEXTURES; ++i) {
+    if (fileLiveries[i] >= 0) {
+      const SDL_Surface* sprite = cars.sprites[cars.liveries[fileLiveries[i]].sprite].indices;
+      oldBytes += sprite->w * sprite->h * 4;
+    }
+  }
+  int spriteCount = (int)cars.sprites.size();
+  CarAtlas carAtlas;
+  if (playerLivery < 0 || trafficLiveries.empty() || !bakeCarAtlas(renderer, cars, carAtlas)) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Couldn't load the cars");
+    return 1;
+  }
+  SDL_Log("Car texture memory before: %d liveries as %d textures, %d bytes", OLD_CAR_TEXTURES, OLD_CAR_TEXTURES, oldBytes);
+  SDL_Log("Car texture memory after: %d liveries tinted from %d sprites in one %dx%d atlas, %d bytes (the same for any number of repaints)",
+          (int)carAtlas.liveries.size(), spriteCount, carAtlas.width, carAtlas.height, carAtlas.width * carAtlas.height * 4);
 
   // Create player vehicle
   Vehicle player;
-  player.texture = playerTexture;
-  player.rect = {SCREEN_WIDTH / 2 - 30, SCREEN_HEIGHT - 100, 60, 80}; // Initial position
+  player.livery = playerLivery;
+  player.rect = {SCREEN_WIDTH / 2 - 30, PLAYER_SCREEN_Y, 60, 80}; // Initial position, in the world
   player.speed = 0;
   player.goingSouth = true; 
 
-  // Create other vehicles 
-  std::vector<Vehicle> vehicles;
-  for (int i = 0; i < 22; ++i) { 
-    Vehicle vehicle;
-    // Choose a texture (example with 4 textures)
-    switch (i % 4) {
-      case 0: vehicle.texture = car1Texture; break;
-      case 1: vehicle.texture = car2Texture; break;
-      case 2: vehicle.texture = car3Texture; break;
-      case 3: vehicle.texture = car4Texture; break;
-      // ... add cases for more textures
-    }
-
-    // Determine direction based on lane
-    int lane = rand() % (NUM_LANES * 2); // Choose from all lanes (south and north)
-    if (lane < NUM_LANES) {
-      vehicle.goingSouth = true;  // Southbound lanes
-      vehicle.rect = {LANE_WIDTH * lane + 10, -80 * i, 60, 80}; 
-    } else {
-      vehicle.goingSouth = false; // Northbound lanes
-      vehicle.rect = {LANE_WIDTH * (lane - NUM_LANES) + 10 + (LANE_WIDTH * NUM_LANES), SCREEN_HEIGHT + 80 * i, 60, 80}; 
-    }
+  // Create the road around the camera, which keeps the player near the bottom of the screen
+  int cameraY = player.rect.y - PLAYER_SCREEN_Y;
+  Road road;
+  initRoad(road, cameraY);
 
-    vehicle.speed = ROAD_SPEED + rand() % 5; 
-    vehicles.push_back(vehicle);
-  }
+  // Create traffic
+  Traffic traffic;
+  initTraffic(traffic, vehicleCount, trafficLiveries, cameraY);
 
   // Game loop
   bool running = true;
@@ -117,49 +1009,38 @@ int main(int argc, char* argv[]) {
       }
     }
 
-    // Update vehicle positions
-    for (auto& vehicle : vehicles) {
-      if (vehicle.goingSouth) {
-        vehicle.rect.y += vehicle.speed;
-        if (vehicle.rect.y > SCREEN_HEIGHT) { 
-          vehicle.rect.y = -80; 
-          int lane = rand() % NUM_LANES; // Choose a southbound lane
-          vehicle.rect.x = LANE_WIDTH * lane + 10; 
-        }
-      } else {
-        vehicle.rect.y -= vehicle.speed;
-        if (vehicle.rect.y < -80) { 
-          vehicle.rect.y = SCREEN_HEIGHT; 
-          int lane = rand() % NUM_LANES; // Choose a northbound lane
-          vehicle.rect.x = LANE_WIDTH * lane + 10 + (LANE_WIDTH * NUM_LANES);
-        }
+    // Drive the player north and scroll the camera and road with it
+    player.rect.y -= player.speed;
+    if (player.rect.y < -WORLD_REBASE) {
+      player.rect.y += WORLD_REBASE;
+      for (auto& segment : road.segments) {
+        segment.y += WORLD_REBASE;
       }
+      rebaseTraffic(traffic, WORLD_REBASE);
     }
+    cameraY = player.rect.y - PLAYER_SCREEN_Y;
+    updateRoad(road, cameraY);
 
-    // Collision detection (basic AABB collision)
-    for (const auto& vehicle : vehicles) {
-      if (SDL_HasIntersection(&player.rect, &vehicle.rect)) {
-        SDL_Log("Collision detected!");
-        // Handle collision (e.g., game over, reduce speed, etc.)
-      }
+    // Update vehicle positions
+    updateTraffic(traffic, cameraY);
+
+    // Collision detection against the cars in the player's lanes
+    if (findCollision(traffic, player.rect)) {
+      SDL_Log("Collision detected!");
+      // Handle collision (e.g., game over, reduce speed, etc.)
     }
 
     // Clear the screen
     SDL_SetRenderDrawColor(renderer, 0x00, 0x7A, 0x33, 0xFF); 
     SDL_RenderClear(renderer);
 
-    // Draw lanes 
-    SDL_SetRenderDrawColor(renderer, 0xFF, 0xFF, 0xFF, 0xFF); 
-    for (int i = 1; i < NUM_LANES; ++i) {
-      SDL_RenderDrawLine(renderer, LANE_WIDTH * i, 0, LANE_WIDTH * i, SCREEN_HEIGHT);
-      SDL_RenderDrawLine(renderer, LANE_WIDTH * i + (LANE_WIDTH * NUM_LANES), 0, LANE_WIDTH * i + (LANE_WIDTH * NUM_LANES), SCREEN_HEIGHT);
-    }
+    // Draw road
+    drawRoad(renderer, road, cameraY);
 
     // Draw vehicles
-    for (const auto& vehicle : vehicles) {
-      SDL_RenderCopy(renderer, vehicle.texture, nullptr, &vehicle.rect);
-    }
-    SDL_RenderCopy(renderer, player.texture, nullptr, &player.rect);
+    drawTraffic(renderer, traffic, carAtlas, cameraY);
+    SDL_Rect playerRect = {player.rect.x, PLAYER_SCREEN_Y, player.rect.w, player.rect.h};
+    drawCar(renderer, carAtlas, player.livery, playerRect);
 
     // Update the screen
     SDL_RenderPresent(renderer);
@@ -169,12 +1050,7 @@ int main(int argc, char* argv[]) {
   }
 
   // Clean up
-  SDL_DestroyTexture(playerTexture);
-  SDL_DestroyTexture(car1Texture);
-  SDL_DestroyTexture(car2Texture);
-  SDL_DestroyTexture(car3Texture);
-  SDL_DestroyTexture(car4Texture);
-  // ... destroy other textures
+  SDL_DestroyTexture(carAtlas.texture);
   SDL_DestroyRenderer(renderer);
   SDL_DestroyWindow(window);
   SDL_Quit();
@@ -5,6 +5,14 @@
 #include <vector>
 #include <random>
 #include <algorithm>
+#include <map>
+#include <string>
+#include <cstring>
+#include <cerrno>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 // Screen dimensions
 const int SCREEN_WIDTH = 800;
@@ -27,6 +35,11 @@ const int BULLET_WIDTH = 5;
 const int BULLET_HEIGHT = 10;
 const int BULLET_SPEED = 10;
 
+// Audio constants
+const char* const MUSIC_PATH = "music.wav";
+const int MUSIC_RING_SIZE = 64 * 1024;   // Decoded music buffered ahead of the mixer (bytes)
+const int MUSIC_SOURCE_SLICE = 4096;     // Source PCM fed to the converter per refill (bytes)
+
 // Structure to hold entity data (player, enemies, bullets)
 struct Entity {
   SDL_Rect rect;
@@ -35,12 +48,42 @@ struct Entity {
   bool active;
 };
 
+// Read-only memory mapping of an asset file
+struct MappedFile {
+  const Uint8* data;
+  size_t size;
+};
+
+// Music streamed from a memory-mapped WAV. A background thread converts the
+// source PCM to the mixer's output format and keeps a small ring buffer
+// topped up; the mixer's music hook drains it.
+struct MusicStream {
+  MappedFile file;
+  const Uint8* pcm;
+  Uint32 pcmLength;
+  Uint32 pcmPos;
+  int sourceFrameSize;
+  int outputFrameSize;
+  Uint8 silence;
+  SDL_AudioStream* converter;
+  Uint8* ring;
+  SDL_atomic_t ringRead;
+  SDL_atomic_t ringWrite;
+  SDL_atomic_t running;
+  SDL_Thread* thread;
+};
+
 // Function declarations
 bool init();
 bool loadMedia();
 void close();
 SDL_Texture* loadTexture(const std::string& path);
 Mix_Chunk* loadSound(const std::string& path);
+bool mapFile(const std::string& path, MappedFile& file);
+void unmapFile(MappedFile& file);
+bool openMusicStream(const std::string& path, MusicStream& stream);
+void closeMusicStream(MusicStream& stream);
+void reportAudioMemory();
 
 // Global variables
 SDL_Window* gWindow = nullptr;
@@ -51,6 +94,9 @@ std::vector<Entity> gPlayerBullets;
 std::vector<Entity> gEnemyBullets;
 SDL_Texture* gBackgroundTexture = nullptr;
 Mix_Music* gMusic = nullptr;
+MusicStream gMusicStream = {};
+MappedFile gMusicFile = {};
+std::map<std::string, Mix_Chunk*> gSoundCache;
 Mix_Chunk* gPlayerFireSound = nullptr;
 Mix_Chunk* gEnemyFireSound = nullptr;
 Mix_Chunk* gExplosionSound = nullptr;
@@ -135,10 +181,18 @@ bool loadMedia() {
   }
 
   // Load sounds
-  gMusic = Mix_LoadMUS("sound.wav");
-  if (gMusic == nullptr) {
-    std::cerr << "Failed to load music! SDL_mixer Error: " << Mix_GetError() << std::endl;
-    return false;
+  // Stream PCM music from the mapped file; anything the stream cannot handle
+  // (e.g. compressed formats) is still decoded lazily by SDL_mixer from the mapping
+  if (!openMusicStream(MUSIC_PATH, gMusicStream)) {
+    if (!mapFile(MUSIC_PATH, gMusicFile)) {
+      std::cerr << "Failed to map music file " << MUSIC_PATH << "!" << std::endl;
+      return false;
+    }
+    gMusic = Mix_LoadMUS_RW(SDL_RWFromConstMem(gMusicFile.data, (int)gMusicFile.size), 1);
+    if (gMusic == nullptr) {
+      std::cerr << "Failed to load music! SDL_mixer Error: " << Mix_GetError() << std::endl;
+      return false;
+    }
   }
 
   gPlayerFireSound = loadSound("sound.wav");
@@ -174,14 +228,17 @@ void close() {
     enemy.texture = nullptr;
   }
 
-  // Free sounds
+  // Free sounds (each cached chunk once, however many roles share it)
+  closeMusicStream(gMusicStream);
   Mix_FreeMusic(gMusic);
   gMusic = nullptr;
-  Mix_FreeChunk(gPlayerFireSound);
+  unmapFile(gMusicFile);
+  for (auto& entry : gSoundCache) {
+    Mix_FreeChunk(entry.second);
+  }
+  gSoundCache.clear();
   gPlayerFireSound = nullptr;
-  Mix_FreeChunk(gEnemyFireSound);
   gEnemyFireSound = nullptr;
-  Mix_FreeChunk(gExplosionSound);
   gExplosionSound = nullptr;
 
   // Destroy window
@@ -212,15 +269,270 @@ SDL_Texture* loadTexture(const std::string& path) {
   return newTexture;
 }
 
-// Load sound from file
+// Load sound from file, decoding each path only once
 Mix_Chunk* loadSound(const std::string& path) {
+  auto cached = gSoundCache.find(path);
+  if (cached != gSoundCache.end()) {
+    return cached->second;
+  }
+
   Mix_Chunk* sound = Mix_LoadWAV(path.c_str());
   if (sound == nullptr) {
     std::cerr << "Unable to load sound " << path << "! SDL_mixer Error: " << Mix_GetError() << std::endl;
+  } else {
+    gSoundCache[path] = sound;
   }
   return sound;
 }
 
+// Map a file read-only into memory
+bool mapFile(const std::string& path, MappedFile& file) {
+  file.data = nullptr;
+  file.size = 0;
+
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    std::cerr << "Unable to open " << path << "! " << strerror(errno) << std::endl;
+    return false;
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) < 0 || info.st_size <= 0) {
+    std::cerr << "Unable to stat " << path << "!" << std::endl;
+    ::close(fd);
+    return false;
+  }
+
+  void* mapping = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (mapping == MAP_FAILED) {
+    std::cerr << "Unable to map " << path << "! " << strerror(errno) << std::endl;
+    return false;
+  }
+
+  // Playback reads front to back, so let the kernel read ahead
+  madvise(mapping, (size_t)info.st_size, MADV_SEQUENTIAL);
+
+  file.data = static_cast<const Uint8*>(mapping);
+  file.size = (size_t)info.st_size;
+  return true;
+}
+
+// Release a mapping made by mapFile
+void unmapFile(MappedFile& file) {
+  if (file.data != nullptr) {
+    munmap(const_cast<Uint8*>(file.data), file.size);
+    file.data = nullptr;
+    file.size = 0;
+  }
+}
+
+// Number of bytes of a mapping currently resident in RAM
+static size_t residentBytes(const MappedFile& file) {
+  if (file.data == nullptr) {
+    return 0;
+  }
+  size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+  size_t pages = (file.size + pageSize - 1) / pageSize;
+  std::vector<unsigned char> residency(pages);
+  if (mincore(const_cast<Uint8*>(file.data), file.size, residency.data()) < 0) {
+    return 0;
+  }
+  size_t resident = 0;
+  for (unsigned char page : residency) {
+    resident += (page & 1) ? pageSize : 0;
+  }
+  return std::min(resident, file.size);
+}
+
+static Uint16 readLE16(const Uint8* p) {
+  return (Uint16)(p[0] | (p[1] << 8));
+}
+
+static Uint32 readLE32(const Uint8* p) {
+  return (Uint32)p[0] | ((Uint32)p[1] << 8) | ((Uint32)p[2] << 16) | ((Uint32)p[3] << 24);
+}
+
+// Locate the PCM data of a RIFF/WAVE file without copying it
+static bool parseWav(const MappedFile& file, SDL_AudioFormat& format, int& channels, int& rate, const Uint8*& pcm, Uint32& length) {
+  if (file.size < 12 || memcmp(file.data, "RIFF", 4) != 0 || memcmp(file.data + 8, "WAVE", 4) != 0) {
+    return false;
+  }
+
+  bool haveFormat = false;
+  size_t offset = 12;
+  while (offset + 8 <= file.size) {
+    const Uint8* chunk = file.data + offset;
+    Uint32 chunkSize = readLE32(chunk + 4);
+    const Uint8* body = chunk + 8;
+    size_t bodySize = std::min((size_t)chunkSize, file.size - offset - 8);
+
+    if (memcmp(chunk, "fmt ", 4) == 0 && bodySize >= 16) {
+      Uint16 tag = readLE16(body);
+      if (tag == 0xFFFE && bodySize >= 26) {
+        tag = readLE16(body + 24); // WAVE_FORMAT_EXTENSIBLE sub-format
+      }
+      channels = readLE16(body + 2);
+      rate = (int)readLE32(body + 4);
+      int bits = readLE16(body + 14);
+      if (tag == 1 && bits == 8) {
+        format = AUDIO_U8;
+      } else if (tag == 1 && bits == 16) {
+        format = AUDIO_S16LSB;
+      } else if (tag == 1 && bits == 32) {
+        format = AUDIO_S32LSB;
+      } else if (tag == 3 && bits == 32) {
+        format = AUDIO_F32LSB;
+      } else {
+        return false;
+      }
+      haveFormat = channels > 0 && rate > 0;
+    } else if (memcmp(chunk, "data", 4) == 0 && haveFormat) {
+      int frameSize = channels * SDL_AUDIO_BITSIZE(format) / 8;
+      pcm = body;
+      length = (Uint32)(bodySize - bodySize % frameSize);
+      return length > 0;
+    }
+
+    offset += 8 + chunkSize + (chunkSize & 1);
+  }
+  return false;
+}
+
+static int ringUsed(MusicStream& stream) {
+  int used = SDL_AtomicGet(&stream.ringWrite) - SDL_AtomicGet(&stream.ringRead);
+  return used < 0 ? used + MUSIC_RING_SIZE : used;
+}
+
+// Background thread: convert source PCM into the ring buffer ahead of the mixer
+static int musicStreamThread(void* data) {
+  MusicStream& stream = *static_cast<MusicStream*>(data);
+  Uint8 block[MUSIC_SOURCE_SLICE * 2];
+
+  while (SDL_AtomicGet(&stream.running)) {
+    // One slot stays empty so a full ring is distinguishable from an empty one
+    int space = MUSIC_RING_SIZE - 1 - ringUsed(stream);
+    int request = std::min(space, (int)sizeof(block));
+    request -= request % stream.outputFrameSize;
+    if (request == 0) {
+      SDL_Delay(5);
+      continue;
+    }
+
+    if (SDL_AudioStreamAvailable(stream.converter) < request) {
+      // Feed the next slice of the mapped file, looping at the end
+      Uint32 slice = std::min((Uint32)MUSIC_SOURCE_SLICE, stream.pcmLength - stream.pcmPos);
+      slice -= slice % stream.sourceFrameSize;
+      SDL_AudioStreamPut(stream.converter, stream.pcm + stream.pcmPos, (int)slice);
+      stream.pcmPos += slice;
+      if (stream.pcmPos + stream.sourceFrameSize > stream.pcmLength) {
+        stream.pcmPos = 0;
+      }
+    }
+
+    int got = SDL_AudioStreamGet(stream.converter, block, request);
+    if (got <= 0) {
+      continue;
+    }
+
+    int write = SDL_AtomicGet(&stream.ringWrite);
+    int first = std::min(got, MUSIC_RING_SIZE - write);
+    memcpy(stream.ring + write, block, first);
+    memcpy(stream.ring, block + first, got - first);
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&stream.ringWrite, (write + got) % MUSIC_RING_SIZE);
+  }
+  return 0;
+}
+
+// Mixer hook: drain the ring buffer, padding with silence on underrun
+static void musicStreamHook(void* data, Uint8* out, int len) {
+  MusicStream& stream = *static_cast<MusicStream*>(data);
+  int available = std::min(ringUsed(stream), len);
+  SDL_MemoryBarrierAcquire();
+
+  int read = SDL_AtomicGet(&stream.ringRead);
+  int first = std::min(available, MUSIC_RING_SIZE - read);
+  memcpy(out, stream.ring + read, first);
+  memcpy(out + first, stream.ring, available - first);
+  SDL_AtomicSet(&stream.ringRead, (read + available) % MUSIC_RING_SIZE);
+
+  memset(out + available, stream.silence, len - available);
+}
+
+// Start streaming a WAV file as music; returns false if it cannot be streamed
+bool openMusicStream(const std::string& path, MusicStream& stream) {
+  stream = {};
+  if (!mapFile(path, stream.file)) {
+    return false;
+  }
+
+  SDL_AudioFormat sourceFormat;
+  int sourceChannels = 0;
+  int sourceRate = 0;
+  if (!parseWav(stream.file, sourceFormat, sourceChannels, sourceRate, stream.pcm, stream.pcmLength)) {
+    unmapFile(stream.file);
+    return false;
+  }
+
+  int outputRate = 0;
+  Uint16 outputFormat = 0;
+  int outputChannels = 0;
+  Mix_QuerySpec(&outputRate, &outputFormat, &outputChannels);
+
+  stream.converter = SDL_NewAudioStream(sourceFormat, (Uint8)sourceChannels, sourceRate, outputFormat, (Uint8)outputChannels, outputRate);
+  if (stream.converter == nullptr) {
+    std::cerr << "Unable to create music converter! SDL Error: " << SDL_GetError() << std::endl;
+    unmapFile(stream.file);
+    return false;
+  }
+
+  stream.sourceFrameSize = sourceChannels * SDL_AUDIO_BITSIZE(sourceFormat) / 8;
+  stream.outputFrameSize = outputChannels * SDL_AUDIO_BITSIZE(outputFormat) / 8;
+  stream.silence = outputFormat == AUDIO_U8 ? 0x80 : 0x00;
+  stream.ring = new Uint8[MUSIC_RING_SIZE];
+  SDL_AtomicSet(&stream.running, 1);
+  stream.thread = SDL_CreateThread(musicStreamThread, "MusicStream", &stream);
+  if (stream.thread == nullptr) {
+    std::cerr << "Unable to start music thread! SDL Error: " << SDL_GetError() << std::endl;
+    closeMusicStream(stream);
+    return false;
+  }
+  return true;
+}
+
+// Stop the music thread and release the stream
+void closeMusicStream(MusicStream& stream) {
+  if (stream.thread != nullptr) {
+    Mix_HookMusic(nullptr, nullptr);
+    SDL_AtomicSet(&stream.running, 0);
+    SDL_WaitThread(stream.thread, nullptr);
+    stream.thread = nullptr;
+  }
+  if (stream.converter != nullptr) {
+    SDL_FreeAudioStream(stream.converter);
+    stream.converter = nullptr;
+  }
+  delete[] stream.ring;
+  stream.ring = nullptr;
+  unmapFile(stream.file);
+}
+
+// Print how much memory the loaded audio keeps resident
+void reportAudioMemory() {
+  size_t chunkBytes = 0;
+  for (const auto& entry : gSoundCache) {
+    chunkBytes += entry.second->alen;
+  }
+  size_t ringBytes = gMusicStream.ring != nullptr ? MUSIC_RING_SIZE : 0;
+  const MappedFile& music = gMusicStream.ring != nullptr ? gMusicStream.file : gMusicFile;
+
+  std::cout << "Audio memory: " << gSoundCache.size() << " sound(s) decoded once, " << chunkBytes << " bytes; "
+            << "music ring buffer " << ringBytes << " bytes; "
+            << MUSIC_PATH << " mapped " << music.size << " bytes, " << residentBytes(music) << " resident; "
+            << "total resident " << chunkBytes + ringBytes + residentBytes(music) << " bytes" << std::endl;
+}
+
 // Main game loop
 int main(int argc, char* args[]) {
   // Initialize SDL
@@ -235,8 +547,14 @@ int main(int argc, char* args[]) {
     return 1;
   }
 
+  reportAudioMemory();
+
   // Play music
-  Mix_PlayMusic(gMusic, -1);
+  if (gMusicStream.thread != nullptr) {
+    Mix_HookMusic(musicStreamHook, &gMusicStream);
+  } else {
+    Mix_PlayMusic(gMusic, -1);
+  }
 
   // Game loop
   bool quit = false;